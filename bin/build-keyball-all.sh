@@ -1,4 +1,11 @@
 #!/bin/sh
+#
+# usage: build-keyball-all.sh [make args...]
+#
+# Extra arguments are passed to make, so the size of an option can be
+# measured for all keymaps with compare-size.sh, like:
+#
+#   build-keyball-all.sh EXTRAFLAGS=-DMOUSE_EXTENDED_REPORT
 
 set -u
 
@@ -27,7 +34,7 @@ for kb in "${keyboards[@]}" ; do
     tmpmaps+=(via_Left via_Both)
   fi
   for km in "${tmpmaps[@]}" ; do
-    ( make SKIP_GIT=yes KEEP_BIN=true COLOR=false "keyball/${kb}:${km}" 2>&1 | tee "${logdir}/${kb}-${km}.log" | LANG=C.utf-8 ts "[${kb}:${km}]" ) &
+    ( make SKIP_GIT=yes KEEP_BIN=true COLOR=false "$@" "keyball/${kb}:${km}" 2>&1 | tee "${logdir}/${kb}-${km}.log" | LANG=C.utf-8 ts "[${kb}:${km}]" ) &
   done
 done
 
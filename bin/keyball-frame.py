@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+#
+# Capture a raw frame of PMW3360DM from Keyball over raw HID, and save it as a
+# PGM image.  The firmware should be built with KEYBALL_FRAME_CAPTURE_ENABLE.
+#
+# usage: keyball-frame.py [-p PID] [--raw] OUTPUT.pgm
+#
+# Requires hidapi: pip install hidapi
+
+import argparse
+import sys
+
+import hid
+
+VENDOR_ID = 0x5957
+USAGE_PAGE = 0xFF60
+USAGE = 0x61
+
+COMMAND = 0x46
+WIDTH = 36
+PIXELS = WIDTH * WIDTH
+PACKET = 32
+CHUNK = PACKET - 2
+
+
+def open_device(pid):
+    for d in hid.enumerate(VENDOR_ID):
+        if d['usage_page'] != USAGE_PAGE or d['usage'] != USAGE:
+            continue
+        if pid is not None and d['product_id'] != pid:
+            continue
+        dev = hid.device()
+        dev.open_path(d['path'])
+        return dev
+    sys.exit('keyball with raw HID is not found')
+
+
+def capture(dev):
+    # The first byte is report ID, which is not sent.
+    dev.write([0x00, COMMAND] + [0] * (PACKET - 1))
+    pixels = bytearray()
+    while len(pixels) < PIXELS:
+        data = dev.read(PACKET, 1000)
+        if not data:
+            sys.exit('timed out: received {} pixels'.format(len(pixels)))
+        if data[0] != COMMAND:
+            continue
+        if data[1] == 0xFF:
+            sys.exit('frame capture is not available on the half')
+        if data[1] != len(pixels) // CHUNK:
+            sys.exit('lost chunk: expected {}, got {}'.format(len(pixels) // CHUNK, data[1]))
+        pixels += bytes(data[2:2 + min(CHUNK, PIXELS - len(pixels))])
+    return pixels
+
+
+def main():
+    p = argparse.ArgumentParser(description='Capture a raw frame of Keyball trackball')
+    p.add_argument('-p', '--pid', type=lambda s: int(s, 0), help='product ID of Keyball, like 0x0400')
+    p.add_argument('--raw', action='store_true', help='save raw values without stretching contrast')
+    p.add_argument('output', help='output PGM file')
+    args = p.parse_args()
+
+    dev = open_device(args.pid)
+    try:
+        pixels = capture(dev)
+    finally:
+        dev.close()
+
+    maxval = max(max(pixels), 1)
+    if args.raw:
+        maxval = 255
+    with open(args.output, 'wb') as f:
+        f.write('P5\n{} {}\n{}\n'.format(WIDTH, WIDTH, maxval).encode('ascii'))
+        f.write(pixels)
+    print('saved {}: min={} max={} avg={:.1f}'.format(args.output, min(pixels), max(pixels), sum(pixels) / PIXELS))
+
+
+if __name__ == '__main__':
+    main()
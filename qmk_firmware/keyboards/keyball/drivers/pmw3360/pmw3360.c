@@ -26,20 +26,250 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PMW3360_SPI_DIVISOR (F_CPU / PMW3360_CLOCKS)
 #define PMW3360_CLOCKS 2000000
 
+// SPI timings in datasheet, in microseconds.  Sub-microsecond ones are
+// rounded up to 1us.
+#define T_SRAD 160      // read address to data
+#define T_SRAD_MOTBR 35 // Motion_Burst address to data
+#define T_SCLK_NCS_R 1  // last SCLK to NCS high after read (120ns)
+#define T_SCLK_NCS_W 35 // last SCLK to NCS high after write
+#define T_SRW_SRR 20    // read to next read or write
+#define T_SWW_SWR 180   // write to next write or read
+#define T_BEXIT 1       // NCS high to exit motion burst (500ns)
+#define T_SROM_BYTE 15  // spacing of SROM bytes
+
 static bool motion_bursting = false;
 
+// ticks_elapsed checks whether n ticks of timer_read32() have been elapsed
+// since stamp.  The timer has only 1ms resolution, so n ticks guarantee at
+// least (n - 1) ms.
+static bool ticks_elapsed(uint32_t stamp, uint8_t n) {
+    return TIMER_DIFF_32(timer_read32(), stamp) >= n;
+}
+
+typedef enum {
+    SROM_IDLE = 0,
+    SROM_RESETTING, // Power_Up_Reset before retry, wait 50ms
+    SROM_LOADING,   // NCS low, sending SROM bytes chunk by chunk
+    SROM_SETTLING,  // NCS high after download, wait 200us
+    SROM_CHECKING,  // SROM CRC self-test is running, wait 10ms
+    SROM_FINISHING, // wait 10ms after all
+} srom_state_t;
+
+static srom_state_t srom_state = SROM_IDLE;
+
+typedef enum {
+    FRAME_IDLE = 0,
+    FRAME_WAITING, // Frame_Capture is written, wait 20ms
+    FRAME_READING, // NCS low, reading Raw_Data_Burst chunk by chunk
+} frame_state_t;
+
+static frame_state_t frame_state = FRAME_IDLE;
+
+static bool resetting = false;
+
+// spi_locked checks whether SROM upload, frame capture or reset is in
+// progress.  Those keep NCS low between steps, or must not be interrupted.
+static bool spi_locked(void) {
+    return srom_state != SROM_IDLE || frame_state != FRAME_IDLE || resetting;
+}
+
+static pmw3360_op_mode_t motion_op_mode = pmw3360_OP_MODE_RUN;
+static bool              motion_lifted  = false;
+
+// motion_decode decodes Motion register value.  It returns true when MOT bit
+// is set and not lifted.
+static bool motion_decode(uint8_t mot) {
+    motion_op_mode = (mot >> 1) & 0x03;
+    motion_lifted  = (mot & 0x08) != 0;
+    return (mot & 0x88) == 0x80;
+}
+
+pmw3360_op_mode_t pmw3360_op_mode_get(void) {
+    return motion_op_mode;
+}
+
+bool pmw3360_lifted_get(void) {
+    return motion_lifted;
+}
+
+typedef enum {
+    BURST_IDLE = 0,
+    BURST_WRITTEN, // NCS high after writing Motion_Burst, wait tSWR
+    BURST_READY,   // motion data is read, wait completion
+} burst_state_t;
+
+static pmw3360_surface_t surface = {0};
+
+#ifdef PMW3360_BURST_TELEMETRY
+static uint32_t surface_timer       = 0;
+static uint32_t surface_squal_sum   = 0;
+static uint32_t surface_shutter_sum = 0;
+static uint8_t  surface_squal_min   = 0xff;
+static uint16_t surface_shutter_max = 0;
+static uint16_t surface_samples     = 0;
+static uint16_t surface_lifted      = 0;
+
+// surface_update accumulates telemetry of a motion burst, and publishes
+// statistics every second.
+static void surface_update(const pmw3360_motion_t *m, bool lifted) {
+    surface_squal_sum += m->squal;
+    surface_shutter_sum += m->shutter;
+    if (m->squal < surface_squal_min) {
+        surface_squal_min = m->squal;
+    }
+    if (m->shutter > surface_shutter_max) {
+        surface_shutter_max = m->shutter;
+    }
+    surface_samples++;
+    if (lifted) {
+        surface_lifted++;
+    }
+    uint32_t now = timer_read32();
+    if (TIMER_DIFF_32(now, surface_timer) < 1000) {
+        return;
+    }
+    surface = (pmw3360_surface_t){
+        .squal_avg   = surface_squal_sum / surface_samples,
+        .squal_min   = surface_squal_min,
+        .shutter_avg = surface_shutter_sum / surface_samples,
+        .shutter_max = surface_shutter_max,
+        .samples     = surface_samples,
+        .lifted      = surface_lifted,
+    };
+    surface_squal_sum   = 0;
+    surface_shutter_sum = 0;
+    surface_squal_min   = 0xff;
+    surface_shutter_max = 0;
+    surface_samples     = 0;
+    surface_lifted      = 0;
+    surface_timer       = now;
+}
+#endif
+
+pmw3360_surface_t pmw3360_surface_get(void) {
+    return surface;
+}
+
+#ifdef PMW3360_BURST_TELEMETRY
+#    define BURST_LEN 12
+#else
+#    define BURST_LEN 6
+#endif
+
+// burst_receive reads motion burst data after sending Motion_Burst address
+// and waiting tSRAD_MOTBR.  It returns true when the sensor has valid motion.
+static bool burst_receive(pmw3360_motion_t *m) {
+    uint8_t buf[BURST_LEN];
+    pmw3360_burst_read(buf, BURST_LEN);
+    bool motion = motion_decode(buf[0]);
+    // buf[1] is Observation, not used.
+    m->x = buf[2] | (buf[3] << 8);
+    m->y = buf[4] | (buf[5] << 8);
+#ifdef PMW3360_BURST_TELEMETRY
+    m->squal        = buf[6];
+    m->raw_data_sum = buf[7];
+    m->max_raw_data = buf[8];
+    m->min_raw_data = buf[9];
+    m->shutter      = (buf[10] << 8) | buf[11];
+    // Treat low SQUAL as lift: the ball is lifted or out of its socket.
+    if (m->squal < PMW3360_LIFT_SQUAL_THRESHOLD) {
+        motion_lifted = true;
+        motion        = false;
+    }
+    surface_update(m, motion_lifted);
+#endif
+    return motion;
+}
+
+static uint32_t motion_skipped = 0;
+
+// motion_pending checks MOTION pin which is asserted (low) by the sensor until
+// motion data is read.  It counts up motion_skipped when not asserted.
+static bool motion_pending(void) {
+#ifdef PMW3360_MOTION_PIN
+    if (readPin(PMW3360_MOTION_PIN)) {
+        motion_skipped++;
+        return false;
+    }
+#endif
+    return true;
+}
+
+uint32_t pmw3360_motion_skipped_get(void) {
+    return motion_skipped;
+}
+
+static burst_state_t    burst_state  = BURST_IDLE;
+static uint32_t         burst_stamp  = 0;
+static pmw3360_motion_t burst_data   = {0};
+static bool             burst_motion = false;
+
+// burst_abort cancels an asynchronous motion burst which waits tSWR, to make
+// SPI available for other register operations.  Data of a ready burst is kept
+// until completed.
+static void burst_abort(void) {
+    if (burst_state == BURST_WRITTEN) {
+        wait_us(T_SWW_SWR - T_SCLK_NCS_W);
+        burst_state = BURST_IDLE;
+    }
+}
+
 bool pmw3360_spi_start(void) {
     return spi_start(PMW3360_NCS_PIN, false, PMW3360_SPI_MODE, PMW3360_SPI_DIVISOR);
 }
 
-uint8_t pmw3360_reg_read(uint8_t addr) {
+void pmw3360_burst_read(uint8_t *buf, uint8_t n) {
+#if defined(__AVR__)
+    for (; n > 0; n--) {
+        SPDR = 0;
+        while (!(SPSR & _BV(SPIF))) {
+        }
+        *buf++ = SPDR;
+    }
+#else
+    spi_receive(buf, n);
+#endif
+}
+
+// Shadow of configuration registers: Control, Config1, Config2, Angle_Tune,
+// Run_Downshift, Rest1/2/3 rates and downshifts, and Lift_Config.
+#define SHADOW_LIFT_CONFIG (pmw3360_Rest3_Rate_Upper - pmw3360_Control + 1)
+
+static uint8_t  shadow_value[SHADOW_LIFT_CONFIG + 1];
+static uint32_t shadow_valid = 0;
+
+// shadow_slot returns index of shadow for a register, or -1 when the register
+// is not shadowed.
+static int8_t shadow_slot(uint8_t addr) {
+    if (addr == pmw3360_Frame_Capture || addr == pmw3360_SROM_Enable) {
+        return -1;
+    }
+    if (addr >= pmw3360_Control && addr <= pmw3360_Rest3_Rate_Upper) {
+        return addr - pmw3360_Control;
+    }
+    if (addr == pmw3360_Lift_Config) {
+        return SHADOW_LIFT_CONFIG;
+    }
+    return -1;
+}
+
+static void shadow_update(uint8_t addr, uint8_t data) {
+    int8_t slot = shadow_slot(addr);
+    if (slot >= 0) {
+        shadow_value[slot] = data;
+        shadow_valid |= (uint32_t)1 << slot;
+    }
+}
+
+static uint8_t reg_read(uint8_t addr) {
+    burst_abort();
     pmw3360_spi_start();
     spi_write(addr & 0x7f);
-    wait_us(160);
+    wait_us(T_SRAD);
     uint8_t data = spi_read();
-    wait_us(1);
+    wait_us(T_SCLK_NCS_R);
     spi_stop();
-    wait_us(19);
+    wait_us(T_SRW_SRR - T_SCLK_NCS_R);
     // Reset motion_bursting mode if read from a register other than motion
     // burst register.
     if (addr != pmw3360_Motion_Burst) {
@@ -48,13 +278,59 @@ uint8_t pmw3360_reg_read(uint8_t addr) {
     return data;
 }
 
-void pmw3360_reg_write(uint8_t addr, uint8_t data) {
+static void reg_write(uint8_t addr, uint8_t data) {
+    burst_abort();
     pmw3360_spi_start();
     spi_write(addr | 0x80);
     spi_write(data);
-    wait_us(35);
+    wait_us(T_SCLK_NCS_W);
     spi_stop();
-    wait_us(145);
+    wait_us(T_SWW_SWR - T_SCLK_NCS_W);
+    if (addr == pmw3360_Power_Up_Reset) {
+        shadow_valid = 0;
+    } else {
+        shadow_update(addr, data);
+    }
+}
+
+// Register operations are ignored while uploading SROM or capturing a frame,
+// because NCS may be kept low to stream data.
+
+uint8_t pmw3360_reg_read(uint8_t addr) {
+    if (spi_locked()) {
+        return 0;
+    }
+    int8_t slot = shadow_slot(addr);
+    if (slot >= 0 && (shadow_valid & ((uint32_t)1 << slot))) {
+        return shadow_value[slot];
+    }
+    uint8_t data = reg_read(addr);
+    shadow_update(addr, data);
+    return data;
+}
+
+void pmw3360_reg_write(uint8_t addr, uint8_t data) {
+    if (spi_locked()) {
+        return;
+    }
+    int8_t slot = shadow_slot(addr);
+    if (slot >= 0 && (shadow_valid & ((uint32_t)1 << slot)) && shadow_value[slot] == data) {
+        return;
+    }
+    reg_write(addr, data);
+}
+
+void pmw3360_resync(void) {
+    if (spi_locked()) {
+        return;
+    }
+    shadow_valid = 0;
+    for (uint8_t addr = pmw3360_Control; addr <= pmw3360_Rest3_Rate_Upper; addr++) {
+        if (shadow_slot(addr) >= 0) {
+            shadow_update(addr, reg_read(addr));
+        }
+    }
+    shadow_update(pmw3360_Lift_Config, reg_read(pmw3360_Lift_Config));
 }
 
 uint8_t pmw3360_cpi_get(void) {
@@ -68,6 +344,36 @@ void pmw3360_cpi_set(uint8_t cpi) {
     pmw3360_reg_write(pmw3360_Config1, cpi);
 }
 
+// Values of Run_Downshift (0x14) to Rest3_Rate_Upper (0x1C) for each power
+// profile which enables rest modes.  Rest rates are (v + 1) ms.
+static const uint8_t power_rests[][pmw3360_Rest3_Rate_Upper - pmw3360_Run_Downshift + 1] PROGMEM = {
+    // BALANCED: Rest1 2ms, Rest2 20ms, Rest3 100ms
+    {0x32, 0x01, 0x00, 0x1F, 0x13, 0x00, 0x5E, 0x63, 0x00},
+    // SAVING: Rest1 10ms, Rest2 100ms, Rest3 500ms
+    {0x0A, 0x09, 0x00, 0x0A, 0x63, 0x00, 0x10, 0xF3, 0x01},
+};
+
+static pmw3360_power_t power_profile = pmw3360_POWER_LATENCY;
+
+void pmw3360_power_set(pmw3360_power_t profile) {
+    power_profile  = profile;
+    uint8_t config = pmw3360_reg_read(pmw3360_Config2) & ~0x20;
+    if (profile == pmw3360_POWER_LATENCY) {
+        pmw3360_reg_write(pmw3360_Config2, config);
+        return;
+    }
+    const uint8_t *p = power_rests[profile - pmw3360_POWER_BALANCED];
+    for (uint8_t addr = pmw3360_Run_Downshift; addr <= pmw3360_Rest3_Rate_Upper; addr++) {
+        pmw3360_reg_write(addr, pgm_read_byte(p++));
+    }
+    // Rest_En
+    pmw3360_reg_write(pmw3360_Config2, config | 0x20);
+}
+
+pmw3360_power_t pmw3360_power_get(void) {
+    return power_profile;
+}
+
 static uint32_t pmw3360_timer      = 0;
 static uint32_t pmw3360_scan_count = 0;
 static uint32_t pmw3360_last_count = 0;
@@ -93,8 +399,7 @@ bool pmw3360_motion_read(pmw3360_motion_t *d) {
 #ifdef DEBUG_PMW3360_SCAN_RATE
     pmw3360_scan_perf_task();
 #endif
-    uint8_t mot = pmw3360_reg_read(pmw3360_Motion);
-    if ((mot & 0x88) != 0x80) {
+    if (!motion_decode(pmw3360_reg_read(pmw3360_Motion))) {
         return false;
     }
     d->x = pmw3360_reg_read(pmw3360_Delta_X_L);
@@ -104,73 +409,366 @@ bool pmw3360_motion_read(pmw3360_motion_t *d) {
     return true;
 }
 
+// burst_transfer reads a motion burst in burst mode.  NCS is kept low only for
+// tSRAD_MOTBR and the transfer, which are too short to return to the scan
+// loop, so it waits in place.
+static bool burst_transfer(pmw3360_motion_t *m) {
+    pmw3360_spi_start();
+    spi_write(pmw3360_Motion_Burst);
+    wait_us(T_SRAD_MOTBR);
+    bool motion = burst_receive(m);
+    spi_stop();
+    // Required NCS in 500ns after motion burst.
+    wait_us(T_BEXIT);
+    return motion;
+}
+
 bool pmw3360_motion_burst(pmw3360_motion_t *d) {
 #ifdef DEBUG_PMW3360_SCAN_RATE
     pmw3360_scan_perf_task();
 #endif
+    if (spi_locked()) {
+        return false;
+    }
+    burst_abort();
+    if (motion_bursting && !motion_pending()) {
+        return false;
+    }
     // Start motion burst if motion burst mode is not started.
     if (!motion_bursting) {
         pmw3360_reg_write(pmw3360_Motion_Burst, 0);
         motion_bursting = true;
     }
 
-    pmw3360_spi_start();
-    spi_write(pmw3360_Motion_Burst);
-    wait_us(35);
-    spi_read(); // skip MOT
-    spi_read(); // skip Observation
-    d->x = spi_read();
-    d->x |= spi_read() << 8;
-    d->y = spi_read();
-    d->y |= spi_read() << 8;
+    pmw3360_motion_t m;
+    if (!burst_transfer(&m)) {
+        return false;
+    }
+    *d = m;
+    return true;
+}
+
+bool pmw3360_motion_burst_start(void) {
+    if (spi_locked() || burst_state != BURST_IDLE || (motion_bursting && !motion_pending())) {
+        return false;
+    }
+    if (motion_bursting) {
+        burst_motion = burst_transfer(&burst_data);
+        burst_state  = BURST_READY;
+        return true;
+    }
+    // Write any value to Motion_Burst register before the first burst, and
+    // return to the scan loop while waiting tSWR.
+    if (!pmw3360_spi_start()) {
+        return false;
+    }
+    spi_write(pmw3360_Motion_Burst | 0x80);
+    spi_write(0);
+    wait_us(T_SCLK_NCS_W);
     spi_stop();
-    // Required NCS in 500ns after motion burst.
-    wait_us(1);
+    motion_bursting = true;
+    burst_state     = BURST_WRITTEN;
+    burst_stamp     = timer_read32();
+    return true;
+}
+
+bool pmw3360_motion_burst_poll(void) {
+    switch (burst_state) {
+        case BURST_WRITTEN:
+            // Two ticks guarantee at least 1ms, which is longer than tSWR.
+            if (!ticks_elapsed(burst_stamp, 2)) {
+                return false;
+            }
+            burst_motion = burst_transfer(&burst_data);
+            burst_state  = BURST_READY;
+            return true;
+
+        case BURST_READY:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool pmw3360_motion_burst_complete(pmw3360_motion_t *d) {
+    if (burst_state != BURST_READY) {
+        return false;
+    }
+#ifdef DEBUG_PMW3360_SCAN_RATE
+    pmw3360_scan_perf_task();
+#endif
+    burst_state = BURST_IDLE;
+    if (!burst_motion) {
+        return false;
+    }
+    *d = burst_data;
     return true;
 }
 
+// reset_write writes Power_Up_Reset.  The sensor boots in 50ms after it.
+static void reset_write(void) {
+    reg_write(pmw3360_Power_Up_Reset, 0x5a);
+    motion_bursting = false;
+}
+
+// reset_discard reads five registers of motion and discards those values,
+// which is required after boot.
+static void reset_discard(void) {
+    for (uint8_t addr = pmw3360_Motion; addr <= pmw3360_Delta_Y_H; addr++) {
+        reg_read(addr);
+    }
+}
+
+void pmw3360_reset_start(void) {
+    if (spi_locked()) {
+        return;
+    }
+    reset_write();
+    resetting = true;
+}
+
+bool pmw3360_reset_finish(void) {
+    resetting = false;
+    reset_discard();
+    // configuration
+    pmw3360_reg_write(pmw3360_Config2, 0x00);
+    // check product ID and revision ID
+    uint8_t pid = pmw3360_reg_read(pmw3360_Product_ID);
+    uint8_t rev = pmw3360_reg_read(pmw3360_Revision_ID);
+    return pid == 0x42 && rev == 0x01;
+}
+
 bool pmw3360_init(void) {
     spi_init();
     setPinOutput(PMW3360_NCS_PIN);
+#ifdef PMW3360_MOTION_PIN
+    setPinInputHigh(PMW3360_MOTION_PIN);
+#endif
     // reboot
     pmw3360_spi_start();
-    pmw3360_reg_write(pmw3360_Power_Up_Reset, 0x5a);
+    pmw3360_reset_start();
     wait_ms(50);
-    // read five registers of motion and discard those values
-    pmw3360_reg_read(pmw3360_Motion);
-    pmw3360_reg_read(pmw3360_Delta_X_L);
-    pmw3360_reg_read(pmw3360_Delta_X_H);
-    pmw3360_reg_read(pmw3360_Delta_Y_L);
-    pmw3360_reg_read(pmw3360_Delta_Y_H);
-    // configuration
-    pmw3360_reg_write(pmw3360_Config2, 0x00);
-    // check product ID and revision ID
-    uint8_t pid = pmw3360_reg_read(pmw3360_Product_ID);
-    uint8_t rev = pmw3360_reg_read(pmw3360_Revision_ID);
+    bool ok = pmw3360_reset_finish();
     spi_stop();
-    return pid == 0x42 && rev == 0x01;
+    return ok;
+}
+
+bool pmw3360_check(void) {
+    if (spi_locked()) {
+        return true;
+    }
+    uint8_t pid = reg_read(pmw3360_Product_ID);
+    uint8_t inv = reg_read(pmw3360_Inverse_Product_ID);
+    return pid == 0x42 && inv == (uint8_t)~0x42;
 }
 
 uint8_t pmw3360_srom_id = 0;
 
-void pmw3360_srom_upload(pmw3360_srom_t srom) {
-    pmw3360_reg_write(pmw3360_Config2, 0x00);
-    pmw3360_reg_write(pmw3360_SROM_Enable, 0x1d);
+// SROM bytes must be spaced by T_SROM_BYTE at least.  Sending a byte takes
+// 4us at 2MHz, so the fast upload waits only the rest of the spacing.
+#define SROM_BYTE_US (8 * 1000000 / PMW3360_CLOCKS)
+
+static pmw3360_srom_t srom_image  = {0};
+static size_t         srom_offset = 0;
+static uint8_t        srom_tries  = 0;
+static uint8_t        srom_got_id = 0;
+static bool           srom_passed = false;
+static uint32_t       srom_stamp  = 0;
+#if defined(DEBUG_PMW3360_SCAN_RATE) && defined(CONSOLE_ENABLE)
+static uint32_t srom_start = 0;
+#endif
+
+// srom_download_begin starts a try to download SROM, and keeps NCS low.
+static void srom_download_begin(void) {
+    reg_write(pmw3360_Config2, 0x00);
+    reg_write(pmw3360_SROM_Enable, 0x1d);
     wait_us(10);
-    pmw3360_reg_write(pmw3360_SROM_Enable, 0x18);
+    reg_write(pmw3360_SROM_Enable, 0x18);
 
     // SROM upload (download for PMW3360) with burst mode
     pmw3360_spi_start();
     spi_write(pmw3360_SROM_Load_Burst | 0x80);
-    wait_us(15);
-    for (size_t i = 0; i < srom.len; i++) {
-        spi_write(pgm_read_byte(srom.data + i));
-        wait_us(15);
+    wait_us(T_SROM_BYTE);
+    srom_offset = 0;
+    srom_state  = SROM_LOADING;
+}
+
+// srom_download_chunk sends a chunk of SROM.  The first try uses the minimum
+// spacing, and retries use the conservative one.
+static void srom_download_chunk(void) {
+    bool   fast = srom_tries == 0;
+    size_t end  = srom_offset + PMW3360_SROM_UPLOAD_CHUNK;
+    if (end > srom_image.len) {
+        end = srom_image.len;
     }
-    spi_stop();
-    wait_us(200);
+    for (; srom_offset < end; srom_offset++) {
+        spi_write(pgm_read_byte(srom_image.data + srom_offset));
+        if (fast) {
+            wait_us(T_SROM_BYTE - SROM_BYTE_US);
+        } else {
+            wait_us(T_SROM_BYTE);
+        }
+    }
+    if (srom_offset >= srom_image.len) {
+        spi_stop();
+        srom_state = SROM_SETTLING;
+        srom_stamp = timer_read32();
+    }
+}
 
-    pmw3360_srom_id = pmw3360_reg_read(pmw3360_SROM_ID);
-    pmw3360_reg_write(pmw3360_Config2, 0x00);
-    wait_ms(10);
+bool pmw3360_srom_upload_start(pmw3360_srom_t srom) {
+    if (spi_locked()) {
+        return false;
+    }
+#if defined(DEBUG_PMW3360_SCAN_RATE) && defined(CONSOLE_ENABLE)
+    srom_start = timer_read32();
+#endif
+    srom_image  = srom;
+    srom_tries  = 0;
+    srom_passed = false;
+    srom_download_begin();
+    return true;
+}
+
+bool pmw3360_srom_upload_task(void) {
+    switch (srom_state) {
+        case SROM_RESETTING:
+            if (ticks_elapsed(srom_stamp, 51)) {
+                reset_discard();
+                srom_download_begin();
+            }
+            return true;
+
+        case SROM_LOADING:
+            srom_download_chunk();
+            return true;
+
+        case SROM_SETTLING:
+            if (ticks_elapsed(srom_stamp, 2)) {
+                srom_got_id = reg_read(pmw3360_SROM_ID);
+                // Start SROM CRC self-test.
+                reg_write(pmw3360_SROM_Enable, 0x15);
+                srom_state = SROM_CHECKING;
+                srom_stamp = timer_read32();
+            }
+            return true;
+
+        case SROM_CHECKING: {
+            if (!ticks_elapsed(srom_stamp, 11)) {
+                return true;
+            }
+            // The result is 0xBEEF in Data_Out_Upper and Data_Out_Lower.
+            uint8_t lo = reg_read(pmw3360_Data_Out_Lower);
+            uint8_t hi = reg_read(pmw3360_Data_Out_Upper);
+            srom_tries++;
+            srom_passed = srom_got_id != 0 && hi == 0xBE && lo == 0xEF;
+            if (!srom_passed && srom_tries < PMW3360_SROM_UPLOAD_MAXTRY) {
+                // Reset the sensor to discard the broken SROM before retry.
+                reset_write();
+                srom_state = SROM_RESETTING;
+                srom_stamp = timer_read32();
+                return true;
+            }
+            if (srom_passed) {
+                pmw3360_srom_id = srom_got_id;
+            }
+            reg_write(pmw3360_Config2, 0x00);
+            srom_state = SROM_FINISHING;
+            srom_stamp = timer_read32();
+            return true;
+        }
+
+        case SROM_FINISHING:
+            if (!ticks_elapsed(srom_stamp, 11)) {
+                return true;
+            }
+            srom_state = SROM_IDLE;
+            // SROM may change configurations.
+            shadow_valid = 0;
+#if defined(DEBUG_PMW3360_SCAN_RATE) && defined(CONSOLE_ENABLE)
+            dprintf("pmw3360 srom upload: %lu ms, %u tries, %s\n", TIMER_DIFF_32(timer_read32(), srom_start), srom_tries, srom_passed ? "ok" : "NG");
+#endif
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+bool pmw3360_srom_uploading(void) {
+    return srom_state != SROM_IDLE;
+}
+
+bool pmw3360_srom_upload(pmw3360_srom_t srom) {
+    if (!pmw3360_srom_upload_start(srom)) {
+        return false;
+    }
+    while (pmw3360_srom_upload_task()) {
+    }
+    return srom_passed;
+}
+
+// Raw_Data_Burst pixels are spaced conservatively, like SROM bytes on retry.
+#define FRAME_PIXEL_US 20
+
+static uint16_t frame_offset = 0;
+static uint32_t frame_stamp  = 0;
+
+bool pmw3360_frame_capture_start(void) {
+    if (spi_locked()) {
+        return false;
+    }
+    // Rest modes must be disabled while capturing.
+    reg_write(pmw3360_Config2, pmw3360_reg_read(pmw3360_Config2) & ~0x20);
+    reg_write(pmw3360_Frame_Capture, 0x83);
+    reg_write(pmw3360_Frame_Capture, 0xc5);
+    // The frame overwrites SROM in RAM of the sensor.
+    pmw3360_srom_id = 0;
+    motion_bursting = false;
+    frame_state     = FRAME_WAITING;
+    frame_stamp     = timer_read32();
+    return true;
+}
+
+uint8_t pmw3360_frame_capture_read(uint8_t *buf, uint8_t n) {
+    switch (frame_state) {
+        case FRAME_WAITING:
+            if (!ticks_elapsed(frame_stamp, 21)) {
+                return 0;
+            }
+            pmw3360_spi_start();
+            spi_write(pmw3360_Raw_Data_Burst);
+            wait_us(T_SRAD);
+            frame_offset = 0;
+            frame_state  = FRAME_READING;
+            // fall through
+
+        case FRAME_READING: {
+            if (n > PMW3360_FRAME_BYTES - frame_offset) {
+                n = PMW3360_FRAME_BYTES - frame_offset;
+            }
+            for (uint8_t i = 0; i < n; i++) {
+                buf[i] = spi_read();
+                wait_us(FRAME_PIXEL_US);
+            }
+            frame_offset += n;
+            if (frame_offset >= PMW3360_FRAME_BYTES) {
+                spi_stop();
+                wait_us(T_BEXIT);
+                frame_state = FRAME_IDLE;
+                // The sensor doesn't track after frame capture until reset.
+                reset_write();
+                resetting = true;
+            }
+            return n;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+bool pmw3360_frame_capturing(void) {
+    return frame_state != FRAME_IDLE;
 }
@@ -27,10 +27,43 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define PMW3360_NCS_PIN B6
 #endif
 
+/// PMW3360_MOTION_PIN specifies a pin connected to MOTION pin of the sensor.
+/// The sensor keeps MOTION pin low until motion data is read, so the driver
+/// skips motion burst entirely while it is high.  When not defined, the
+/// driver polls motion burst always.
+//#define PMW3360_MOTION_PIN D0
+
+/// PMW3360_BURST_TELEMETRY reads all 12 bytes of motion burst, which contain
+/// SQUAL, Raw_Data_Sum, Maximum/Minimum_Raw_data and Shutter, in the same
+/// burst.  It enables pmw3360_surface_get() and lift detection by SQUAL.
+//#define PMW3360_BURST_TELEMETRY
+
+/// PMW3360_LIFT_SQUAL_THRESHOLD is the SQUAL value below which the ball is
+/// treated as lifted (or out of its socket) and motion is ignored, in
+/// addition to Lift_Stat.  This works only when PMW3360_BURST_TELEMETRY is
+/// defined.  Define 0 to use Lift_Stat only.
+#ifndef PMW3360_LIFT_SQUAL_THRESHOLD
+#    define PMW3360_LIFT_SQUAL_THRESHOLD 16
+#endif
+
+/// PMW3360_SROM_UPLOAD_MAXTRY is the maximum number of SROM uploads until the
+/// SROM CRC self-test passes.  The first try uses the minimum inter-byte
+/// spacing, and retries fall back to the conservative spacing after
+/// Power_Up_Reset, which adds 50ms for each retry.
+#ifndef PMW3360_SROM_UPLOAD_MAXTRY
+#    define PMW3360_SROM_UPLOAD_MAXTRY 3
+#endif
+
+/// PMW3360_SROM_UPLOAD_CHUNK is the number of SROM bytes which are sent by a
+/// call of pmw3360_srom_upload_task().  64 bytes take about 1ms.
+#ifndef PMW3360_SROM_UPLOAD_CHUNK
+#    define PMW3360_SROM_UPLOAD_CHUNK 64
+#endif
+
 /// DEBUG_PMW3360_SCAN_RATE enables scan performance counter.
 /// It records scan count in a last second and enables pmw3360_scan_rate_get().
 /// Additionally, it will be logged automatically when defined CONSOLE_ENABLE
-/// and `debug_enable = true`.
+/// and `debug_enable = true`, with the time which SROM upload took.
 //#define DEBUG_PMW3360_SCAN_RATE
 
 //////////////////////////////////////////////////////////////////////////////
@@ -44,8 +77,25 @@ typedef struct {
 typedef struct {
     int16_t x;
     int16_t y;
+#ifdef PMW3360_BURST_TELEMETRY
+    uint8_t  squal;
+    uint8_t  raw_data_sum;
+    uint8_t  max_raw_data;
+    uint8_t  min_raw_data;
+    uint16_t shutter;
+#endif
 } pmw3360_motion_t;
 
+/// Surface quality statistics in a last second, collected from motion bursts.
+typedef struct {
+    uint8_t  squal_avg;
+    uint8_t  squal_min;
+    uint16_t shutter_avg;
+    uint16_t shutter_max;
+    uint16_t samples;
+    uint16_t lifted;
+} pmw3360_surface_t;
+
 typedef enum {
     pmw3360_Product_ID                 = 0x00,
     pmw3360_Revision_ID                = 0x01,
@@ -102,6 +152,33 @@ enum {
     pmw3360_MAXCPI = 0x77, // = 119: 12000 CPI
 };
 
+/// Power profiles, which program Rest_En of Config2, Run_Downshift and
+/// Rest1/2/3 rate and downshift registers.
+///
+/// Estimated frame period of each mode, which is the worst latency to wake
+/// up by motion in the mode:
+///
+///     profile   | Run->Rest1 | Rest1 | Rest2 | Rest3
+///     ----------+------------+-------+-------+------
+///     LATENCY   | never      |     - |     - |     -
+///     BALANCED  | 500ms idle |   2ms |  20ms | 100ms
+///     SAVING    | 100ms idle |  10ms | 100ms | 500ms
+///
+/// Run mode scans the surface at its full frame rate on every profile.
+typedef enum {
+    pmw3360_POWER_LATENCY  = 0, // rest modes are disabled (default)
+    pmw3360_POWER_BALANCED = 1,
+    pmw3360_POWER_SAVING   = 2,
+} pmw3360_power_t;
+
+/// OP_Mode bits of Motion register.
+typedef enum {
+    pmw3360_OP_MODE_RUN   = 0,
+    pmw3360_OP_MODE_REST1 = 1,
+    pmw3360_OP_MODE_REST2 = 2,
+    pmw3360_OP_MODE_REST3 = 3,
+} pmw3360_op_mode_t;
+
 //////////////////////////////////////////////////////////////////////////////
 // Exported values (touch carefully)
 
@@ -120,7 +197,70 @@ extern const pmw3360_srom_t pmw3360_srom_0x81;
 /// It will return true when succeeded, otherwise false.
 bool pmw3360_init(void);
 
-void pmw3360_srom_upload(pmw3360_srom_t srom);
+/// pmw3360_reset_start starts power up reset of the sensor without waiting.
+/// Motion bursts fail and register operations are ignored until
+/// pmw3360_reset_finish() is called, which must be 50ms later at least.
+/// The register shadow is invalidated, so configurations should be restored
+/// after that.
+void pmw3360_reset_start(void);
+
+/// pmw3360_reset_finish finishes power up reset started by
+/// pmw3360_reset_start().  It returns true when Product_ID and Revision_ID
+/// are valid.
+bool pmw3360_reset_finish(void);
+
+/// pmw3360_check validates Product_ID and Inverse_Product_ID, to detect brown
+/// out of the sensor or a glitch of SPI.  It takes about 360us, and returns
+/// true without SPI access while SROM upload, frame capture or reset is in
+/// progress.
+bool pmw3360_check(void);
+
+/// pmw3360_srom_upload uploads SROM to the sensor, and verifies it with SROM
+/// CRC self-test.  It retries up to PMW3360_SROM_UPLOAD_MAXTRY times, and
+/// returns true when the self-test passed.  pmw3360_srom_id is updated only
+/// when succeeded.
+bool pmw3360_srom_upload(pmw3360_srom_t srom);
+
+/// pmw3360_srom_upload_start starts an asynchronous SROM upload.  Call
+/// pmw3360_srom_upload_task() repeatedly until it returns false.
+/// It returns false when another upload is in progress.
+///
+/// While uploading, motion bursts fail and register operations are ignored
+/// (pmw3360_reg_read() returns 0), because NCS is kept low between chunks.
+bool pmw3360_srom_upload_start(pmw3360_srom_t srom);
+
+/// pmw3360_srom_upload_task sends a next chunk of SROM, or advances the
+/// verification without waiting.  It returns false when the upload has been
+/// finished, then pmw3360_srom_id is updated if it succeeded.
+bool pmw3360_srom_upload_task(void);
+
+/// pmw3360_srom_uploading checks whether an SROM upload is in progress.
+bool pmw3360_srom_uploading(void);
+
+/// PMW3360_FRAME_BYTES is the number of pixels in a raw frame, 36x36.
+#define PMW3360_FRAME_WIDTH 36
+#define PMW3360_FRAME_BYTES (PMW3360_FRAME_WIDTH * PMW3360_FRAME_WIDTH)
+
+/// pmw3360_frame_capture_start starts capturing a raw frame for diagnostics.
+/// It disables rest modes, and returns false when SROM upload or another
+/// capture is in progress.  Call pmw3360_frame_capture_read() repeatedly
+/// until pmw3360_frame_capturing() returns false.
+///
+/// While capturing, motion bursts fail and register operations are ignored
+/// like SROM upload.  Frame capture overwrites SROM and stops tracking, so
+/// the sensor is reset after the last pixel like pmw3360_reset_start().  Then
+/// call pmw3360_reset_finish() 50ms later, upload SROM again, and restore
+/// CPI and the power profile.
+bool pmw3360_frame_capture_start(void);
+
+/// pmw3360_frame_capture_read reads next pixels of the frame into buf, up to
+/// n bytes, with a single Raw_Data_Burst across calls.  Pixels are in row
+/// major order.  It returns the number of pixels read, which is 0 while
+/// waiting for the frame.  A pixel takes about 25us.
+uint8_t pmw3360_frame_capture_read(uint8_t *buf, uint8_t n);
+
+/// pmw3360_frame_capturing checks whether a frame capture is in progress.
+bool pmw3360_frame_capturing(void);
 
 /// pmw3360_motion_read gets a motion data by Motion register.
 /// This requires to write a dummy data to pmw3360_Motion register
@@ -130,20 +270,74 @@ bool pmw3360_motion_read(pmw3360_motion_t *d);
 /// pmw3360_motion_burst gets a motion data by Motion_Burst command.
 /// This requires to write a dummy data to pmw3360_Motion_Burst register
 /// just before.
+/// It returns false when the sensor reports no motion (MOT bit is cleared or
+/// lifted), then d is not modified.
 bool pmw3360_motion_burst(pmw3360_motion_t *d);
 
+/// pmw3360_motion_burst_start starts an asynchronous motion burst.
+/// In burst mode, it reads motion data at once, waiting only tSRAD_MOTBR
+/// (35us).  Otherwise it writes Motion_Burst register to enter burst mode,
+/// and leaves tSWR gap to pmw3360_motion_burst_poll().
+/// It returns false when another burst is in progress or SPI is not
+/// available.
+bool pmw3360_motion_burst_start(void);
+
+/// pmw3360_motion_burst_poll advances an asynchronous motion burst without
+/// waiting for tSWR, which is checked against a timestamp of 1ms resolution.
+/// It returns true when motion data is ready to be completed.
+bool pmw3360_motion_burst_poll(void);
+
+/// pmw3360_motion_burst_complete gets a motion data of the ready burst and
+/// makes the state machine idle.  It returns false when no burst is ready or
+/// the sensor reports no motion, then d is not modified.
+bool pmw3360_motion_burst_complete(pmw3360_motion_t *d);
+
+/// pmw3360_op_mode_get gets operation mode, which was decoded from Motion
+/// register by the last motion read or burst.
+pmw3360_op_mode_t pmw3360_op_mode_get(void);
+
+/// pmw3360_lifted_get gets Lift_Stat, which was decoded from Motion register
+/// by the last motion read or burst.
+bool pmw3360_lifted_get(void);
+
+/// pmw3360_surface_get gets surface quality statistics in a last second.
+/// It doesn't access SPI.  This works only when PMW3360_BURST_TELEMETRY is
+/// defined, otherwise all of values are 0.
+pmw3360_surface_t pmw3360_surface_get(void);
+
 /// pmw3360_scan_rate_get gets count of scan in a last second.
 /// This works only when DEBUG_PMW3360_SCAN_RATE is defined.
 uint32_t pmw3360_scan_rate_get(void);
 
-// TODO: document
+/// pmw3360_motion_skipped_get gets count of motion bursts which were skipped
+/// because MOTION pin was not asserted.
+/// This works only when PMW3360_MOTION_PIN is defined.
+uint32_t pmw3360_motion_skipped_get(void);
+
+/// pmw3360_cpi_get gets CPI value of Config1 register: CPI = (v + 1) * 100.
+/// It is served from the register shadow, without SPI access usually.
 uint8_t pmw3360_cpi_get(void);
 
-// TODO: document
+/// pmw3360_cpi_set sets CPI value to Config1 register: CPI = (v + 1) * 100.
+/// It does nothing when the value is same as the register shadow.
 void pmw3360_cpi_set(uint8_t cpi);
 
+/// pmw3360_power_set programs registers for a power profile.  Writes which
+/// are same as the register shadow are skipped, so it is cheap to call
+/// repeatedly.
+void pmw3360_power_set(pmw3360_power_t profile);
+
+/// pmw3360_power_get gets the power profile set last.
+pmw3360_power_t pmw3360_power_get(void);
+
 //////////////////////////////////////////////////////////////////////////////
 // Register operations
+//
+// The driver keeps a shadow of configuration registers: Control, Config1,
+// Config2, Angle_Tune, Run_Downshift, Rest1/2/3 rates and downshifts, and
+// Lift_Config.  Reads of these registers are served from the shadow, and
+// writes of the same value as the shadow are skipped.  The shadow is
+// invalidated by Power_Up_Reset and SROM upload.
 
 /// pmw3360_reg_write writes a value to a register.
 void pmw3360_reg_write(uint8_t addr, uint8_t data);
@@ -151,11 +345,20 @@ void pmw3360_reg_write(uint8_t addr, uint8_t data);
 /// pmw3360_reg_read reads a value from a register.
 uint8_t pmw3360_reg_read(uint8_t addr);
 
+/// pmw3360_resync reloads the register shadow from the sensor.  Use this when
+/// the sensor may have been changed behind the driver, like brown out.
+void pmw3360_resync(void);
+
 //////////////////////////////////////////////////////////////////////////////
 // SPI operations
 
 bool pmw3360_spi_start(void);
 
+/// pmw3360_burst_read reads n bytes continuously into buf, while NCS is low.
+/// On AVR it runs a tight loop on SPI data register, without per-byte call
+/// and timeout overhead of spi_read().
+void pmw3360_burst_read(uint8_t *buf, uint8_t n);
+
 void inline pmw3360_spi_stop(void) {
     spi_stop();
 }
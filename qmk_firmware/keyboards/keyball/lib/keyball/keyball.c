@@ -22,6 +22,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "keyball.h"
 #include "drivers/pmw3360/pmw3360.h"
+#ifdef KEYBALL_PMW3360_DEFER_SROM_UPLOAD
+#    include "usb_device_state.h"
+#endif
+#ifdef KEYBALL_FRAME_CAPTURE_ENABLE
+#    include "raw_hid.h"
+#    include "usb_descriptor.h"
+#endif
 
 #include <string.h>
 
@@ -51,6 +58,11 @@ keyball_t keyball = {
     .scroll_mode = false,
     .scroll_div  = 0,
 
+#ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+    .report_fast     = true,
+    .report_interval = KEYBALL_REPORTMOUSE_INTERVAL,
+#endif
+
     .pressing_keys = { BL, BL, BL, BL, BL, BL, 0 },
 };
 
@@ -78,21 +90,38 @@ static int16_t add16(int16_t a, int16_t b) {
     return r;
 }
 
-// divmod16 divides *v by div, returns the quotient, and assigns the remainder
-// to *v.
-static int16_t divmod16(int16_t *v, int16_t div) {
-    int16_t r = *v / div;
-    *v -= r * div;
-    return r;
+// MOUSE_XY_MAX is the maximum of X and Y of mouse report.  Extended report
+// has 16-bit X and Y.
+#ifdef MOUSE_EXTENDED_REPORT
+#    define MOUSE_XY_MAX 32767
+#else
+#    define MOUSE_XY_MAX 127
+#endif
+
+// MOUSE_HV_MAX is the maximum of H and V of mouse report.
+#ifdef WHEEL_EXTENDED_REPORT
+#    define MOUSE_HV_MAX 32767
+#else
+#    define MOUSE_HV_MAX 127
+#endif
+
+// clip2hv clips an integer fit into H and V of mouse report.
+static inline int16_t clip2hv(int16_t v) {
+    return (v) < -MOUSE_HV_MAX ? -MOUSE_HV_MAX : (v) > MOUSE_HV_MAX ? MOUSE_HV_MAX : v;
 }
 
-// clip2int8 clips an integer fit into int8_t.
-static inline int8_t clip2int8(int16_t v) {
-    return (v) < -127 ? -127 : (v) > 127 ? 127 : (int8_t)v;
+// clip2xy clips an integer fit into X and Y of mouse report.
+static inline mouse_xy_report_t clip2xy(int16_t v) {
+    return (v) < -MOUSE_XY_MAX ? -MOUSE_XY_MAX : (v) > MOUSE_XY_MAX ? MOUSE_XY_MAX : (mouse_xy_report_t)v;
 }
 
 #ifdef OLED_ENABLE
-static const char *format_4d(int8_t d) {
+// clip4d clips v into 4 columns of format_4d(), for 16-bit reports.
+static int16_t clip4d(int16_t v) {
+    return v < -999 ? -999 : v > 999 ? 999 : v;
+}
+
+static const char *format_4d(int16_t d) {
     static char buf[5] = {0}; // max width (4) + NUL (1)
     char        lead   = ' ';
     if (d < 0) {
@@ -138,6 +167,315 @@ static void add_scroll_div(int8_t delta) {
 //////////////////////////////////////////////////////////////////////////////
 // Pointing device driver
 
+#if defined(KEYBALL_PMW3360_UPLOAD_SROM_ID)
+#    if KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x04
+#        define KEYBALL_PMW3360_SROM pmw3360_srom_0x04
+#    elif KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x81
+#        define KEYBALL_PMW3360_SROM pmw3360_srom_0x81
+#    else
+#        error Invalid value for KEYBALL_PMW3360_UPLOAD_SROM_ID. Please choose 0x04 or 0x81 or disable it.
+#    endif
+#endif
+
+#if defined(KEYBALL_PMW3360_SROM)
+static bool srom_pending = false;
+
+// srom_upload_task uploads SROM chunk by chunk when srom_pending is set, then
+// restores CPI which was reset by SROM.  With deferred upload, it waits until
+// USB has been configured on primary.
+static void srom_upload_task(void) {
+    if (srom_pending) {
+#    ifdef KEYBALL_PMW3360_DEFER_SROM_UPLOAD
+        if (is_keyboard_master() && usb_device_state != USB_DEVICE_STATE_CONFIGURED) {
+            return;
+        }
+#    endif
+        srom_pending = false;
+        pmw3360_srom_upload_start(KEYBALL_PMW3360_SROM);
+        return;
+    }
+    if (pmw3360_srom_uploading() && !pmw3360_srom_upload_task()) {
+        pmw3360_cpi_set(keyball_get_cpi() - 1);
+        pmw3360_power_set(pmw3360_power_get());
+    }
+}
+#endif
+
+// The sensor watchdog restarts the sensor also after frame capture, which
+// overwrites SROM of the sensor.
+#if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0 || defined(KEYBALL_FRAME_CAPTURE_ENABLE)
+#    define SENSOR_WATCHDOG_ENABLE
+#endif
+
+// adjust_layout applies the current combination of balls to the layout.
+// Primary applies VIA layout options too.  Secondary reports the combination
+// to primary by KEYBALL_SYNC later.
+#if defined(SPLIT_KEYBOARD) || defined(SENSOR_WATCHDOG_ENABLE)
+static void adjust_layout(void) {
+#ifdef SPLIT_KEYBOARD
+    if (!is_keyboard_master()) {
+        keyball_on_adjust_layout(KEYBALL_ADJUST_SECONDARY);
+        return;
+    }
+#    ifdef VIA_ENABLE
+    // adjust VIA layout options according to current combination.
+    uint8_t  layouts = (keyball.this_have_ball ? (is_keyboard_left() ? 0x02 : 0x01) : 0x00) | (keyball.that_have_ball ? (is_keyboard_left() ? 0x01 : 0x02) : 0x00);
+    uint32_t curr    = via_get_layout_options();
+    uint32_t next    = (curr & ~0x3) | layouts;
+    if (next != curr) {
+        via_set_layout_options(next);
+    }
+#    endif
+#endif
+    keyball_on_adjust_layout(KEYBALL_ADJUST_PRIMARY);
+}
+#endif
+
+#ifdef SENSOR_WATCHDOG_ENABLE
+typedef enum {
+    WATCHDOG_IDLE = 0,
+    WATCHDOG_RESETTING, // power up reset is started, wait 50ms
+    WATCHDOG_RESTORING, // wait SROM upload
+} watchdog_state_t;
+
+static watchdog_state_t watchdog_state   = WATCHDOG_IDLE;
+static uint32_t         watchdog_stamp   = 0;
+static uint32_t         watchdog_start   = 0;
+static bool             watchdog_restart = false;
+
+#    ifdef SPLIT_KEYBOARD
+// watchdog_resync asks rpc_sync_handler() of secondary to offer totals of
+// motion as a new base after the sensor is restored, so primary drops motion
+// of the failing sensor.
+static volatile bool watchdog_resync = false;
+#    endif
+
+#    if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+static uint8_t watchdog_suspect = 0;
+
+// sensor_plausible checks motion of a burst, and counts up impossible ones to
+// trigger the validation.
+static bool sensor_plausible(const pmw3360_motion_t *d) {
+    if (abs(d->x) <= KEYBALL_SENSOR_WATCHDOG_MAXDELTA && abs(d->y) <= KEYBALL_SENSOR_WATCHDOG_MAXDELTA) {
+        watchdog_suspect = 0;
+        return true;
+    }
+    if (watchdog_suspect < 0xff) {
+        watchdog_suspect++;
+    }
+    return false;
+}
+#    else
+#        define sensor_plausible(d) true
+#    endif
+
+#    ifdef KEYBALL_FRAME_CAPTURE_ENABLE
+// sensor_restart restores the sensor which has been reset after frame
+// capture, through the recovery steps of the watchdog.  It is not counted as
+// a recovery.
+static void sensor_restart(void) {
+    watchdog_restart = true;
+    watchdog_stamp   = timer_read32();
+    watchdog_state   = WATCHDOG_RESETTING;
+}
+#    endif
+
+// sensor_watchdog_task validates the sensor periodically, and re-initializes
+// it step by step when the validation failed.  It probes the sensor also
+// while this half has no ball, to detect hot-plug of the ball module.
+static void sensor_watchdog_task(void) {
+    uint32_t now = timer_read32();
+    switch (watchdog_state) {
+        case WATCHDOG_IDLE:
+#    if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+#        ifdef KEYBALL_PMW3360_SROM
+            if (srom_pending || pmw3360_srom_uploading()) {
+                return;
+            }
+#        endif
+            if (watchdog_suspect < 3 && TIMER_DIFF_32(now, watchdog_stamp) < KEYBALL_SENSOR_WATCHDOG_INTERVAL) {
+                return;
+            }
+            watchdog_stamp   = now;
+            watchdog_suspect = 0;
+            if (pmw3360_check() == keyball.this_have_ball) {
+                // healthy, or still detached.
+                return;
+            }
+            if (watchdog_start == 0) {
+                watchdog_start = now;
+            }
+            pmw3360_reset_start();
+            if (keyball.this_have_ball) {
+                keyball.this_sensor_failures++;
+                dprintf("keyball:sensor_watchdog: failed #%u\n", keyball.this_sensor_failures);
+            } else {
+                dprintf("keyball:sensor_watchdog: attached\n");
+                // registers are locked while resetting, so this just selects
+                // the profile to be restored.
+                pmw3360_power_set(KEYBALL_PMW3360_POWER_PROFILE);
+            }
+            watchdog_state = WATCHDOG_RESETTING;
+#    endif
+            return;
+
+        case WATCHDOG_RESETTING:
+            if (TIMER_DIFF_32(now, watchdog_stamp) <= 50) {
+                return;
+            }
+            watchdog_stamp = now;
+            if (!pmw3360_reset_finish()) {
+                // not responding after reset: the ball module is detached.
+                // It will be probed at the next validation.
+                if (keyball.this_have_ball) {
+                    dprintf("keyball:sensor_watchdog: detached\n");
+                    keyball.this_have_ball = false;
+                    adjust_layout();
+                }
+                watchdog_start   = 0;
+                watchdog_restart = false;
+                watchdog_state   = WATCHDOG_IDLE;
+                return;
+            }
+#    ifdef KEYBALL_PMW3360_SROM
+            srom_pending = true;
+#    else
+            pmw3360_cpi_set(keyball_get_cpi() - 1);
+            pmw3360_power_set(pmw3360_power_get());
+#    endif
+            watchdog_state = WATCHDOG_RESTORING;
+            return;
+
+        case WATCHDOG_RESTORING:
+#    ifdef KEYBALL_PMW3360_SROM
+            if (srom_pending || pmw3360_srom_uploading()) {
+                return;
+            }
+#    endif
+            // discard motion which was accumulated while failing.  Secondary
+            // asks primary to rebase, before counting up the recovery.
+            keyball.this_motion.x = 0;
+            keyball.this_motion.y = 0;
+#    ifdef SPLIT_KEYBOARD
+            watchdog_resync = true;
+#    endif
+            if (watchdog_restart) {
+                // restarted after frame capture.
+                watchdog_restart = false;
+            } else if (keyball.this_have_ball) {
+                keyball.this_sensor_recoveries++;
+                keyball.this_sensor_recovery_ms = TIMER_DIFF_32(now, watchdog_start);
+                dprintf("keyball:sensor_watchdog: recovered #%u in %u ms\n", keyball.this_sensor_recoveries, keyball.this_sensor_recovery_ms);
+            } else {
+                keyball.this_have_ball = true;
+                adjust_layout();
+            }
+            watchdog_start = 0;
+            watchdog_stamp = now;
+            watchdog_state = WATCHDOG_IDLE;
+            return;
+    }
+}
+#else
+#    define sensor_plausible(d) true
+#endif
+
+#if KEYBALL_FILTER_LEFT != KEYBALL_FILTER_NONE || KEYBALL_FILTER_RIGHT != KEYBALL_FILTER_NONE
+static struct {
+    bool             moving;  // deadzone: not at rest
+    uint32_t         stamp;   // deadzone: last motion while moving
+    uint32_t         last;    // last burst
+    keyball_motion_t carry;   // EMA and median: motion not reported yet
+    keyball_motion_t hist[2]; // median: last two bursts
+} motion_filter_state = {0};
+
+static int16_t median3(int16_t a, int16_t b, int16_t c) {
+    if (a > b) {
+        int16_t t = a;
+        a         = b;
+        b         = t;
+    }
+    return c <= a ? a : c >= b ? b : c;
+}
+
+// half_up halves v rounding away from zero, so EMA doesn't strand a carry of
+// 1 count.
+static int16_t half_up(int16_t v) {
+    return v >= 0 ? (v + 1) >> 1 : -((1 - v) >> 1);
+}
+
+// motion_filter applies the filter of this ball to motion of a burst,
+// including bursts without motion.  Modes are constant, so unused filters are
+// removed by compiler.
+static void motion_filter(pmw3360_motion_t *d) {
+    uint8_t  mode = is_keyboard_left() ? KEYBALL_FILTER_LEFT : KEYBALL_FILTER_RIGHT;
+    uint32_t now  = timer_read32();
+    // bursts may be skipped at rest (by MOTION pin), then history is stale.
+    if (TIMER_DIFF_32(now, motion_filter_state.last) > KEYBALL_REPORTMOUSE_INTERVAL) {
+        motion_filter_state.hist[0] = motion_filter_state.hist[1] = (keyball_motion_t){0};
+    }
+    motion_filter_state.last = now;
+    if (mode == KEYBALL_FILTER_DEADZONE) {
+        if (d->x == 0 && d->y == 0) {
+            return;
+        }
+        if (motion_filter_state.moving && TIMER_DIFF_32(now, motion_filter_state.stamp) >= KEYBALL_FILTER_DEADZONE_TIMEOUT) {
+            motion_filter_state.moving = false;
+        }
+        if (!motion_filter_state.moving && abs(d->x) <= KEYBALL_FILTER_DEADZONE_COUNTS && abs(d->y) <= KEYBALL_FILTER_DEADZONE_COUNTS) {
+            d->x = 0;
+            d->y = 0;
+            return;
+        }
+        motion_filter_state.moving = true;
+        motion_filter_state.stamp  = now;
+    } else if (mode == KEYBALL_FILTER_EMA) {
+        int16_t x                   = add16(d->x, motion_filter_state.carry.x);
+        int16_t y                   = add16(d->y, motion_filter_state.carry.y);
+        d->x                        = half_up(x);
+        d->y                        = half_up(y);
+        motion_filter_state.carry.x = x - d->x;
+        motion_filter_state.carry.y = y - d->y;
+    } else if (mode == KEYBALL_FILTER_MEDIAN) {
+        // motion out of the median is carried over and released by half every
+        // burst, so a spike is spread over later bursts rather than dropped.
+        keyball_motion_t *h  = motion_filter_state.hist;
+        keyball_motion_t *c  = &motion_filter_state.carry;
+        int16_t           x  = median3(h[0].x, h[1].x, d->x);
+        int16_t           y  = median3(h[0].y, h[1].y, d->y);
+        int16_t           cx = add16(c->x, d->x - x);
+        int16_t           cy = add16(c->y, d->y - y);
+        h[0]                 = h[1];
+        h[1]                 = (keyball_motion_t){d->x, d->y};
+        d->x                 = add16(x, half_up(cx));
+        d->y                 = add16(y, half_up(cy));
+        c->x                 = cx - half_up(cx);
+        c->y                 = cy - half_up(cy);
+    }
+}
+
+// motion_filter_flush takes motion which EMA or median holds back, after
+// bursts have stopped at rest by MOTION pin.  It is called when no burst is
+// ready.
+static void motion_filter_flush(pmw3360_motion_t *d) {
+    uint8_t           mode = is_keyboard_left() ? KEYBALL_FILTER_LEFT : KEYBALL_FILTER_RIGHT;
+    keyball_motion_t *c    = &motion_filter_state.carry;
+    if ((mode != KEYBALL_FILTER_EMA && mode != KEYBALL_FILTER_MEDIAN) || (c->x == 0 && c->y == 0)) {
+        return;
+    }
+    // two ticks without a burst guarantee 1ms at least.
+    if (TIMER_DIFF_32(timer_read32(), motion_filter_state.last) < 2) {
+        return;
+    }
+    d->x = c->x;
+    d->y = c->y;
+    *c   = (keyball_motion_t){0};
+}
+#else
+#    define motion_filter(d)
+#    define motion_filter_flush(d)
+#endif
+
 #if KEYBALL_MODEL == 46
 void keyboard_pre_init_kb(void) {
     keyball.this_have_ball = pmw3360_init();
@@ -150,16 +488,14 @@ void pointing_device_driver_init(void) {
     keyball.this_have_ball = pmw3360_init();
 #endif
     if (keyball.this_have_ball) {
-#if defined(KEYBALL_PMW3360_UPLOAD_SROM_ID)
-#    if KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x04
-        pmw3360_srom_upload(pmw3360_srom_0x04);
-#    elif KEYBALL_PMW3360_UPLOAD_SROM_ID == 0x81
-        pmw3360_srom_upload(pmw3360_srom_0x81);
-#    else
-#        error Invalid value for KEYBALL_PMW3360_UPLOAD_SROM_ID. Please choose 0x04 or 0x81 or disable it.
-#    endif
+#if defined(KEYBALL_PMW3360_SROM) && defined(KEYBALL_PMW3360_DEFER_SROM_UPLOAD)
+        // run with stock firmware until SROM is uploaded by housekeeping.
+        srom_pending = true;
+#elif defined(KEYBALL_PMW3360_SROM)
+        pmw3360_srom_upload(KEYBALL_PMW3360_SROM);
 #endif
         pmw3360_cpi_set(CPI_DEFAULT - 1);
+        pmw3360_power_set(KEYBALL_PMW3360_POWER_PROFILE);
     }
 }
 
@@ -171,42 +507,148 @@ void pointing_device_driver_set_cpi(uint16_t cpi) {
     keyball_set_cpi(cpi);
 }
 
+#ifdef KEYBALL_ACCEL_ENABLE
+
+#    define ACCEL_STEPS 16
+
+// Build Q8.8 gain tables from curve specs by compiler.  Gain of a step is
+// evaluated at the lowest speed of the step.
+#    define ACCEL_SPEED(i) ((i) << KEYBALL_ACCEL_SPEED_SHIFT)
+#    define ACCEL_RAMP(o, s, i) (256 + (s) * (ACCEL_SPEED(i) - (o)))
+#    define ACCEL_GAIN(o, s, l, i) (ACCEL_SPEED(i) <= (o) ? 256 : ACCEL_RAMP(o, s, i) >= (l) ? (l) : ACCEL_RAMP(o, s, i))
+#    define ACCEL_INV(o, s, l, i) (65536UL / ACCEL_GAIN(o, s, l, i))
+#    define ACCEL_TABLE_(f, o, s, l) \
+        { f(o, s, l, 0), f(o, s, l, 1), f(o, s, l, 2),  f(o, s, l, 3),  f(o, s, l, 4),  f(o, s, l, 5),  f(o, s, l, 6),  f(o, s, l, 7), \
+          f(o, s, l, 8), f(o, s, l, 9), f(o, s, l, 10), f(o, s, l, 11), f(o, s, l, 12), f(o, s, l, 13), f(o, s, l, 14), f(o, s, l, 15) }
+#    define ACCEL_TABLE(f, spec) ACCEL_TABLE_(f, spec)
+
+static const uint16_t accel_gains[3][ACCEL_STEPS] PROGMEM = {
+    ACCEL_TABLE(ACCEL_GAIN, KEYBALL_ACCEL_CURVE1),
+    ACCEL_TABLE(ACCEL_GAIN, KEYBALL_ACCEL_CURVE2),
+    ACCEL_TABLE(ACCEL_GAIN, KEYBALL_ACCEL_CURVE3),
+};
+
+// Inverse gains in Q8.8, to convert motion left by clipping back.
+static const uint16_t accel_invs[3][ACCEL_STEPS] PROGMEM = {
+    ACCEL_TABLE(ACCEL_INV, KEYBALL_ACCEL_CURVE1),
+    ACCEL_TABLE(ACCEL_INV, KEYBALL_ACCEL_CURVE2),
+    ACCEL_TABLE(ACCEL_INV, KEYBALL_ACCEL_CURVE3),
+};
+
+// Fractions of accelerated motion in Q8, carried over to next reports.
+static uint8_t accel_frac_x = 0;
+static uint8_t accel_frac_y = 0;
+
+// mul_q8 multiplies v by Q8.8 value q, and keeps the fraction in *frac.
+static int16_t mul_q8(int16_t v, uint16_t q, uint8_t *frac) {
+    int32_t t = (int32_t)v * q + *frac;
+    *frac     = t & 0xff;
+    t >>= 8;
+    return t > 32767 ? 32767 : t < -32767 ? -32767 : t;
+}
+
+// ACCEL_FAST_SCALE scales speed of a fast report to the regular report
+// interval, in Q4.
+#    if defined(KEYBALL_REPORTMOUSE_FAST_INTERVAL) && KEYBALL_REPORTMOUSE_INTERVAL > KEYBALL_REPORTMOUSE_FAST_INTERVAL
+#        define ACCEL_FAST_SCALE (KEYBALL_REPORTMOUSE_INTERVAL * 16 / KEYBALL_REPORTMOUSE_FAST_INTERVAL)
+#    endif
+
+// accel_step gets a step of the tables by speed of m, which is approximated
+// as max + min / 2 of absolute X and Y.
+static uint8_t accel_step(const keyball_motion_t *m) {
+    uint16_t ax = abs(m->x), ay = abs(m->y);
+    uint32_t v  = ax > ay ? ax + (ay >> 1) : ay + (ax >> 1);
+#    ifdef ACCEL_FAST_SCALE
+    if (keyball.report_interval == KEYBALL_REPORTMOUSE_FAST_INTERVAL) {
+        v = (v * ACCEL_FAST_SCALE) >> 4;
+    }
+#    endif
+    v >>= KEYBALL_ACCEL_SPEED_SHIFT;
+    return v >= ACCEL_STEPS ? ACCEL_STEPS - 1 : v;
+}
+
+__attribute__((weak)) uint8_t keyball_on_select_accel_curve(uint8_t curve) {
+    return curve;
+}
+#endif
+
 __attribute__((weak)) void keyball_on_apply_motion_to_mouse_move(keyball_motion_t *m, report_mouse_t *r, bool is_left) {
+#ifdef KEYBALL_ACCEL_ENABLE
+    // accelerate motion in place.  Motion left by clipping is decelerated back
+    // at the end.
+    uint8_t curve = keyball_on_select_accel_curve(keyball_get_accel_curve());
+    if (curve > 3) {
+        // the hook may return any value, but there are only 3 tables.
+        curve = 3;
+    }
+    uint8_t step = accel_step(m);
+    if (curve > 0) {
+        uint16_t gain = pgm_read_word(&accel_gains[curve - 1][step]);
+        m->x          = mul_q8(m->x, gain, &accel_frac_x);
+        m->y          = mul_q8(m->y, gain, &accel_frac_y);
+    }
+#endif
 #if KEYBALL_MODEL == 61 || KEYBALL_MODEL == 39 || KEYBALL_MODEL == 147 || KEYBALL_MODEL == 44
-    r->x = clip2int8(m->y);
-    r->y = clip2int8(m->x);
+    r->x = clip2xy(m->y);
+    r->y = clip2xy(m->x);
+    // consume reported motion, the rest is carried over to next reports.
+    m->x -= r->y;
+    m->y -= r->x;
     if (is_left) {
         r->x = -r->x;
         r->y = -r->y;
     }
 #elif KEYBALL_MODEL == 46
-    r->x = clip2int8(m->x);
-    r->y = -clip2int8(m->y);
+    r->x = clip2xy(m->x);
+    r->y = -clip2xy(m->y);
+    // consume reported motion, the rest is carried over to next reports.
+    m->x -= r->x;
+    m->y += r->y;
 #else
 #    error("unknown Keyball model")
 #endif
-    // clear motion
-    m->x = 0;
-    m->y = 0;
+#ifdef KEYBALL_ACCEL_ENABLE
+    if (curve > 0 && (m->x != 0 || m->y != 0)) {
+        uint16_t inv = pgm_read_word(&accel_invs[curve - 1][step]);
+        uint8_t  fx = 0, fy = 0;
+        m->x = mul_q8(m->x, inv, &fx);
+        m->y = mul_q8(m->y, inv, &fy);
+    }
+#endif
+}
+
+// Remainders of scroll for each ball, in counts.
+static keyball_motion_t scroll_remains[2] = {0};
+
+// scroll_consume converts motion v to scroll units: v / 2^n rounded toward
+// zero, and carries over the remainder by *rem.
+static int16_t scroll_consume(int16_t v, uint8_t n, int16_t *rem) {
+    int32_t t = (int32_t)v + *rem;
+    int32_t q = t < 0 ? -(-t >> n) : t >> n;
+    *rem      = t - (q << n);
+    return q > 32767 ? 32767 : q < -32767 ? -32767 : q;
 }
 
 __attribute__((weak)) void keyball_on_apply_motion_to_mouse_scroll(keyball_motion_t *m, report_mouse_t *r, bool is_left) {
     // consume motion of trackball.
-    int16_t div = 1 << (keyball_get_scroll_div() - 1);
-    int16_t x = divmod16(&m->x, div);
-    int16_t y = divmod16(&m->y, div);
+    keyball_motion_t *rem = &scroll_remains[is_left ? 1 : 0];
+    uint8_t           n   = keyball_get_scroll_div() - 1;
+    int16_t           x   = scroll_consume(m->x, n, &rem->x);
+    int16_t           y   = scroll_consume(m->y, n, &rem->y);
+    m->x                  = 0;
+    m->y                  = 0;
 
     // apply to mouse report.
 #if KEYBALL_MODEL == 61 || KEYBALL_MODEL == 39 || KEYBALL_MODEL == 147 || KEYBALL_MODEL == 44
-    r->h = clip2int8(y);
-    r->v = -clip2int8(x);
+    r->h = clip2hv(y);
+    r->v = -clip2hv(x);
     if (is_left) {
         r->h = -r->h;
         r->v = -r->v;
     }
 #elif KEYBALL_MODEL == 46
-    r->h = clip2int8(x);
-    r->v = clip2int8(y);
+    r->h = clip2hv(x);
+    r->v = clip2hv(y);
 #else
 #    error("unknown Keyball model")
 #endif
@@ -243,20 +685,58 @@ __attribute__((weak)) void keyball_on_apply_motion_to_mouse_scroll(keyball_motio
 static void motion_to_mouse(keyball_motion_t *m, report_mouse_t *r, bool is_left, bool as_scroll) {
     if (as_scroll) {
         keyball_on_apply_motion_to_mouse_scroll(m, r, is_left);
-    } else {
+    } else if (m->x != 0 || m->y != 0) {
         keyball_on_apply_motion_to_mouse_move(m, r, is_left);
     }
 }
 
+#ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+// report_fast_active checks whether either ball has moved recently, which
+// selects the fast report interval.
+static bool report_fast_active(void) {
+    return keyball.report_fast && TIMER_DIFF_32(timer_read32(), keyball.motion_last) < KEYBALL_REPORTMOUSE_FAST_TIMEOUT;
+}
+
+static void report_fast_touch(void) {
+    keyball.motion_last = timer_read32();
+}
+
+#    define REPORT_INTERVAL (report_fast_active() ? KEYBALL_REPORTMOUSE_FAST_INTERVAL : KEYBALL_REPORTMOUSE_INTERVAL)
+#    define GETMOTION_INTERVAL (report_fast_active() ? KEYBALL_REPORTMOUSE_FAST_INTERVAL : KEYBALL_TX_GETMOTION_INTERVAL)
+#else
+#    define report_fast_active() false
+#    define report_fast_touch()
+#    define REPORT_INTERVAL KEYBALL_REPORTMOUSE_INTERVAL
+#    define GETMOTION_INTERVAL KEYBALL_TX_GETMOTION_INTERVAL
+#endif
+
 static inline bool should_report(void) {
     uint32_t now = timer_read32();
 #if defined(KEYBALL_REPORTMOUSE_INTERVAL) && KEYBALL_REPORTMOUSE_INTERVAL > 0
-    // throttling mouse report rate.
-    static uint32_t last = 0;
-    if (TIMER_DIFF_32(now, last) < KEYBALL_REPORTMOUSE_INTERVAL) {
-        return false;
+#    ifdef KEYBALL_REPORTMOUSE_DRAIN
+    // a saturated report means that motion is carried over, so report it
+    // back-to-back.
+    bool draining = abs(keyball.last_mouse.x) == MOUSE_XY_MAX || abs(keyball.last_mouse.y) == MOUSE_XY_MAX;
+#    else
+    bool draining = false;
+#    endif
+    // throttling mouse report rate.  Deadlines are kept on a fixed grid, so
+    // reports don't drift by the scan loop.  Re-phase when it is late by an
+    // interval or more.
+    static uint32_t last     = 0;
+    uint8_t         interval = REPORT_INTERVAL;
+#    ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+    keyball.report_interval = interval;
+#    endif
+    if (!draining) {
+        if (TIMER_DIFF_32(now, last) < interval) {
+            return false;
+        }
+        last += interval;
+        if (TIMER_DIFF_32(now, last) >= interval) {
+            last = now;
+        }
     }
-    last = now;
 #endif
 #if defined(KEYBALL_SCROLLBALL_INHIVITOR) && KEYBALL_SCROLLBALL_INHIVITOR > 0
     if (TIMER_DIFF_32(now, keyball.scroll_mode_changed) < KEYBALL_SCROLLBALL_INHIVITOR) {
@@ -264,21 +744,96 @@ static inline bool should_report(void) {
         keyball.this_motion.y = 0;
         keyball.that_motion.x = 0;
         keyball.that_motion.y = 0;
+        memset(scroll_remains, 0, sizeof(scroll_remains));
     }
 #endif
     return true;
 }
 
+#ifdef DEBUG_KEYBALL_REPORT_JITTER
+// report_jitter_update records intervals between reports with motion, and
+// logs statistics every second.  Intervals over 100ms are idle, not jitter.
+static void report_jitter_update(const report_mouse_t *r) {
+    static uint32_t last = 0, stamp = 0, sum = 0;
+    static uint16_t count = 0;
+    static uint8_t  min = 0xff, max = 0;
+    if (r->x == 0 && r->y == 0 && r->h == 0 && r->v == 0) {
+        return;
+    }
+    uint32_t now = timer_read32();
+    uint32_t d   = TIMER_DIFF_32(now, last);
+    last         = now;
+    if (d < 100) {
+        sum += d;
+        count++;
+        min = d < min ? d : min;
+        max = d > max ? d : max;
+    }
+    if (TIMER_DIFF_32(now, stamp) < 1000) {
+        return;
+    }
+    if (count > 0) {
+        dprintf("keyball:report: %u reports, interval min=%u avg=%lu max=%u ms\n", count, min, sum / count, max);
+    }
+    sum   = 0;
+    count = 0;
+    min   = 0xff;
+    max   = 0;
+    stamp = now;
+}
+#endif
+
+#ifdef SPLIT_KEYBOARD
+// Running totals of motion on secondary, which are sent as they are by
+// rpc_sync_handler() without masking interrupts.  The sensor poll is the only
+// writer: it writes the unpublished buffer, then publishes it by a single
+// byte store.  The handler runs in the transport interrupt, so it never reads
+// a buffer being written.  Totals wrap around.
+static volatile keyball_motion_t motion_totals[2] = {0};
+static volatile uint8_t          motion_published = 0;
+
+// motion_unsent is set after publishing totals, and is cleared by the
+// handler.  A race between them results in a needless fetch at most.
+static volatile bool motion_unsent = false;
+#endif
+
+// motion_accumulate adds motion of this ball, which is reported by primary
+// or is sent to primary by secondary.
+static void motion_accumulate(int16_t x, int16_t y) {
+    report_fast_touch();
+#ifdef SPLIT_KEYBOARD
+    if (!is_keyboard_master()) {
+        uint8_t curr          = motion_published;
+        uint8_t next          = curr ^ 1;
+        motion_totals[next].x = (uint16_t)motion_totals[curr].x + (uint16_t)x;
+        motion_totals[next].y = (uint16_t)motion_totals[curr].y + (uint16_t)y;
+        motion_published      = next;
+        motion_unsent         = true;
+        return;
+    }
+#endif
+    keyball.this_motion.x = add16(keyball.this_motion.x, x);
+    keyball.this_motion.y = add16(keyball.this_motion.y, y);
+}
+
 report_mouse_t pointing_device_driver_get_report(report_mouse_t rep) {
     // fetch from optical sensor.
     if (keyball.this_have_ball) {
         pmw3360_motion_t d = {0};
-        if (pmw3360_motion_burst(&d)) {
-            ATOMIC_BLOCK_FORCEON {
-                keyball.this_motion.x = add16(keyball.this_motion.x, d.x);
-                keyball.this_motion.y = add16(keyball.this_motion.y, d.y);
+        if (pmw3360_motion_burst_poll()) {
+            if (!pmw3360_motion_burst_complete(&d) || !sensor_plausible(&d)) {
+                d.x = 0;
+                d.y = 0;
             }
+            motion_filter(&d);
+        } else {
+            motion_filter_flush(&d);
+        }
+        if (d.x != 0 || d.y != 0) {
+            motion_accumulate(d.x, d.y);
         }
+        // start next burst, it will be completed in later calls.
+        pmw3360_motion_burst_start();
     }
     // report mouse event, if keyboard is primary.
     if (is_keyboard_master() && should_report()) {
@@ -287,95 +842,273 @@ report_mouse_t pointing_device_driver_get_report(report_mouse_t rep) {
         motion_to_mouse(&keyball.that_motion, &rep, !is_keyboard_left(), keyball.scroll_mode ^ keyball.this_have_ball);
         // store mouse report for OLED.
         keyball.last_mouse = rep;
+#ifdef DEBUG_KEYBALL_REPORT_JITTER
+        report_jitter_update(&rep);
+#endif
     }
     return rep;
 }
 
 //////////////////////////////////////////////////////////////////////////////
-// Split RPC
+// Suspend
 
-#ifdef SPLIT_KEYBOARD
-
-static void rpc_get_info_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    keyball_info_t info = {
-        .ballcnt = keyball.this_have_ball ? 1 : 0,
-    };
-    *(keyball_info_t *)out_data = info;
-    keyball_on_adjust_layout(KEYBALL_ADJUST_SECONDARY);
-}
+static bool            suspended    = false;
+static pmw3360_power_t power_resume = KEYBALL_PMW3360_POWER_PROFILE;
 
-static void rpc_get_info_invoke(void) {
-    static bool     negotiated = false;
-    static uint32_t last_sync  = 0;
-    static int      round      = 0;
-    uint32_t        now        = timer_read32();
-    if (negotiated || TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETINFO_INTERVAL) {
+// suspend_apply switches the sensor to the power saving profile while USB is
+// suspended, and restores the profile which was used on entering.  Secondary
+// follows primary by KEYBALL_SYNC.
+static void suspend_apply(bool suspend) {
+    if (suspend == suspended) {
         return;
     }
-    last_sync = now;
-    round++;
-    keyball_info_t recv = {0};
-    if (!transaction_rpc_exec(KEYBALL_GET_INFO, 0, NULL, sizeof(recv), &recv)) {
-        if (round < KEYBALL_TX_GETINFO_MAXTRY) {
-            dprintf("keyball:rpc_get_info_invoke: missed #%d\n", round);
-            return;
-        }
+    suspended = suspend;
+    if (!keyball.this_have_ball) {
+        return;
     }
-    negotiated             = true;
-    keyball.that_enable    = true;
-    keyball.that_have_ball = recv.ballcnt > 0;
-    dprintf("keyball:rpc_get_info_invoke: negotiated #%d %d\n", round, keyball.that_have_ball);
+    if (suspend) {
+        power_resume = pmw3360_power_get();
+        pmw3360_power_set(pmw3360_POWER_SAVING);
+    } else {
+        pmw3360_power_set(power_resume);
+    }
+}
 
-    // split keyboard negotiation completed.
+//////////////////////////////////////////////////////////////////////////////
+// Split RPC
 
-#    ifdef VIA_ENABLE
-    // adjust VIA layout options according to current combination.
-    uint8_t  layouts = (keyball.this_have_ball ? (is_keyboard_left() ? 0x02 : 0x01) : 0x00) | (keyball.that_have_ball ? (is_keyboard_left() ? 0x01 : 0x02) : 0x00);
-    uint32_t curr    = via_get_layout_options();
-    uint32_t next    = (curr & ~0x3) | layouts;
-    if (next != curr) {
-        via_set_layout_options(next);
+#ifdef SPLIT_KEYBOARD
+
+#if KEYBALL_TX_MOTION_PENDING
+// MOTION_PENDING_BIT is the top bit of the first row of each half.  It is
+// masked on all models, so it never emits a key event.
+#    define MOTION_PENDING_BIT ((matrix_row_t)1 << (sizeof(matrix_row_t) * 8 - 1))
+#    define MOTION_PENDING_ROW(is_left) ((is_left) ? 0 : MATRIX_ROWS / 2)
+
+// declare matrix buffer which defined in quantum/matrix_common.c
+extern matrix_row_t matrix[MATRIX_ROWS];
+
+// matrix_slave_scan_kb is called on secondary after the matrix has been sent
+// to primary, so the bit is carried by the next matrix sync.  Debounce may
+// overwrite the row in between, then the bit is carried a scan later.
+void matrix_slave_scan_kb(void) {
+    matrix_row_t *row = &matrix[MOTION_PENDING_ROW(is_keyboard_left())];
+    if (motion_unsent) {
+        *row |= MOTION_PENDING_BIT;
+    } else {
+        *row &= ~MOTION_PENDING_BIT;
     }
-#    endif
+    matrix_slave_scan_user();
+}
 
-    keyball_on_adjust_layout(KEYBALL_ADJUST_PRIMARY);
+static bool that_motion_pending(void) {
+    return (matrix[MOTION_PENDING_ROW(!is_keyboard_left())] & MOTION_PENDING_BIT) != 0;
 }
+#endif
 
-static void rpc_get_motion_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    *(keyball_motion_t *)out_data = keyball.this_motion;
-    // clear motion
-    keyball.this_motion.x = 0;
-    keyball.this_motion.y = 0;
+#ifdef DEBUG_KEYBALL_TX_RATE
+static uint16_t tx_sync_count = 0;
+
+// tx_rate_task logs the count of KEYBALL_SYNC transactions every second.
+static void tx_rate_task(void) {
+    static uint32_t stamp = 0;
+    uint32_t        now   = timer_read32();
+    if (TIMER_DIFF_32(now, stamp) < 1000) {
+        return;
+    }
+    dprintf("keyball:tx: %u sync transactions/s\n", tx_sync_count);
+    tx_sync_count = 0;
+    stamp           = now;
 }
+#endif
+
+// Suspend state and CPI of primary, which are applied by
+// housekeeping_task_kb(), out of the transport interrupt.  CPI takes SPI
+// transfers, which may collide with a motion burst of the sensor poll.
+static volatile bool    suspend_requested = false;
+static volatile uint8_t cpi_requested     = 0;
+static volatile bool    cpi_pending       = false;
 
-static void rpc_get_motion_invoke(void) {
-    static uint32_t last_sync = 0;
-    uint32_t        now       = timer_read32();
-    if (TIMER_DIFF_32(now, last_sync) < KEYBALL_TX_GETMOTION_INTERVAL) {
+// cpi_apply applies CPI which primary has requested.
+static void cpi_apply(void) {
+    if (!cpi_pending) {
         return;
     }
-    keyball_motion_t recv = {0};
-    if (transaction_rpc_exec(KEYBALL_GET_MOTION, 0, NULL, sizeof(recv), &recv)) {
-        keyball.that_motion.x = add16(keyball.that_motion.x, recv.x);
-        keyball.that_motion.y = add16(keyball.that_motion.y, recv.y);
+    // clear first: a request during this is applied at the next call.
+    cpi_pending = false;
+    keyball_set_cpi(cpi_requested);
+}
+
+// rpc_sync_handler takes CPI and suspend state from primary, and replies the count of balls
+// and running totals of motion, in a single transaction.
+//
+// Primary computes motion from differences of totals, so a lost reply is
+// made up by the next one, and nothing is counted twice.  After either half
+// is reset, replies are marked as fresh until primary takes their totals as
+// its base, which is known by the base in requests.  Fresh replies hold the
+// same totals, so motion meanwhile is sent after primary has taken the base.
+static bool             sync_fresh   = true;
+static keyball_motion_t sync_replied = {0};
+
+static void rpc_sync_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
+    static bool adjusted = false;
+
+    const keyball_sync_request_t *req = (const keyball_sync_request_t *)in_data;
+    if (req->cpi != keyball.cpi_value) {
+        cpi_requested = req->cpi;
+        cpi_pending   = true;
+    }
+    suspend_requested = req->suspended;
+    // offer current totals as a new base when primary has been reset.
+    uint8_t i      = motion_published;
+    bool    rebase = !req->base_known && !sync_fresh;
+#ifdef SENSOR_WATCHDOG_ENABLE
+    // or when the sensor has been restored, even if fresh already.
+    rebase          = rebase || watchdog_resync;
+    watchdog_resync = false;
+#endif
+    if (rebase) {
+        sync_fresh     = true;
+        sync_replied.x = motion_totals[i].x;
+        sync_replied.y = motion_totals[i].y;
+    } else if (req->base_known && sync_fresh && req->base.x == sync_replied.x && req->base.y == sync_replied.y) {
+        sync_fresh = false;
+    }
+    if (!sync_fresh) {
+        sync_replied.x = motion_totals[i].x;
+        sync_replied.y = motion_totals[i].y;
+        motion_unsent  = false;
+    }
+
+    *(keyball_sync_reply_t *)out_data = (keyball_sync_reply_t){
+        .ballcnt    = keyball.this_have_ball ? 1 : 0,
+        .recoveries = keyball.this_sensor_recoveries,
+        .fresh      = sync_fresh,
+        .totals     = sync_replied,
+    };
+
+    // adjust at the first negotiation.  Later changes are adjusted by the
+    // sensor watchdog.
+    if (!adjusted) {
+        adjusted = true;
+        keyball_on_adjust_layout(KEYBALL_ADJUST_SECONDARY);
     }
-    last_sync = now;
-    return;
 }
 
-static void rpc_set_cpi_handler(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data) {
-    keyball_set_cpi(*(keyball_cpi_t *)in_data);
+// Totals of motion on secondary, which have been applied to that_motion.
+// They are unknown until the first reply after this half has started.
+static keyball_motion_t that_base       = {0};
+static bool             that_base_known = false;
+
+static void rpc_sync_apply_motion(const keyball_sync_reply_t *recv) {
+    if (recv->fresh || !that_base_known) {
+        // either half has been reset: take totals as the base.
+        dprintf("keyball:rpc_sync_invoke: that half is fresh\n");
+        that_base       = recv->totals;
+        that_base_known = true;
+    }
+    int16_t dx = (uint16_t)recv->totals.x - (uint16_t)that_base.x;
+    int16_t dy = (uint16_t)recv->totals.y - (uint16_t)that_base.y;
+    that_base  = recv->totals;
+
+    if (recv->recoveries != keyball.that_sensor_recoveries) {
+        // the sensor of the other half has been recovered.
+        dprintf("keyball:rpc_sync_invoke: that sensor recovered #%u\n", recv->recoveries);
+        keyball.that_sensor_recoveries = recv->recoveries;
+        keyball.that_motion.x          = 0;
+        keyball.that_motion.y          = 0;
+    }
+    if (dx != 0 || dy != 0) {
+        report_fast_touch();
+    }
+    keyball.that_motion.x = add16(keyball.that_motion.x, dx);
+    keyball.that_motion.y = add16(keyball.that_motion.y, dy);
 }
 
-static void rpc_set_cpi_invoke(void) {
-    if (!keyball.cpi_changed) {
+// rpc_sync_invoke runs KEYBALL_SYNC when any of negotiation, motion, CPI and
+// suspend is due.  Each RPC costs several transfers over the split link, so
+// all of them share a transaction.
+static void rpc_sync_invoke(void) {
+    static bool     negotiated  = false;
+    static bool     retry       = false;
+    static bool     synced_susp = false;
+    static uint32_t last_info   = 0;
+    static uint32_t last_motion = 0;
+    static int      round       = 0;
+    uint32_t        now         = timer_read32();
+
+#if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+    // after negotiation, re-negotiate slowly to detect hot-plug of the ball
+    // module on secondary, which its sensor watchdog finds.
+    bool info_due = TIMER_DIFF_32(now, last_info) >= (negotiated ? KEYBALL_TX_GETINFO_RENEGOTIATE_INTERVAL : KEYBALL_TX_GETINFO_INTERVAL);
+#else
+    // without the watchdog, the ball of secondary never changes after boot.
+    bool info_due = !negotiated && TIMER_DIFF_32(now, last_info) >= KEYBALL_TX_GETINFO_INTERVAL;
+#endif
+    bool motion_due  = false;
+    bool cpi_due     = false;
+    bool suspend_due = false;
+    if (negotiated && keyball.that_have_ball) {
+#if KEYBALL_TX_MOTION_PENDING
+        motion_due = that_motion_pending();
+#else
+        motion_due = true;
+#endif
+        // a failed sync may have cleared the pending bit, so retry it.
+        motion_due = (motion_due || retry) && TIMER_DIFF_32(now, last_motion) >= GETMOTION_INTERVAL;
+        cpi_due     = keyball.cpi_changed;
+        suspend_due = suspended != synced_susp;
+    }
+    if (!info_due && !motion_due && !cpi_due && !suspend_due) {
         return;
     }
-    keyball_cpi_t req = keyball.cpi_value;
-    if (!transaction_rpc_send(KEYBALL_SET_CPI, sizeof(req), &req)) {
+    if (info_due) {
+        last_info = now;
+        if (!negotiated) {
+            round++;
+        }
+    }
+    if (motion_due) {
+        last_motion = now;
+    }
+#ifdef DEBUG_KEYBALL_TX_RATE
+    tx_sync_count++;
+#endif
+
+    keyball_sync_request_t req = {
+        .cpi        = keyball.cpi_value,
+        .suspended  = suspended,
+        .base_known = that_base_known,
+        .base       = that_base,
+    };
+    keyball_sync_reply_t recv = {0};
+    if (transaction_rpc_exec(KEYBALL_SYNC, sizeof(req), &req, sizeof(recv), &recv)) {
+        keyball.cpi_changed = false;
+        retry               = false;
+        synced_susp         = req.suspended;
+        rpc_sync_apply_motion(&recv);
+    } else {
+        retry = true;
+        if (negotiated) {
+            return;
+        }
+        if (round < KEYBALL_TX_GETINFO_MAXTRY) {
+            dprintf("keyball:rpc_sync_invoke: missed #%d\n", round);
+            return;
+        }
+    }
+
+    bool that_have_ball = recv.ballcnt > 0;
+    if (negotiated && that_have_ball == keyball.that_have_ball) {
         return;
     }
-    keyball.cpi_changed = false;
+    negotiated             = true;
+    keyball.that_enable    = true;
+    keyball.that_have_ball = that_have_ball;
+    dprintf("keyball:rpc_sync_invoke: negotiated #%d %d\n", round, keyball.that_have_ball);
+
+    // split keyboard negotiation completed.
+    adjust_layout();
 }
 
 #endif
@@ -406,10 +1139,10 @@ void keyball_oled_render_ballinfo(void) {
 
     // 1st line, "Ball" label, mouse x, y, h, and v.
     oled_write_P(PSTR("Ball\xB1"), false);
-    oled_write(format_4d(keyball.last_mouse.x), false);
-    oled_write(format_4d(keyball.last_mouse.y), false);
-    oled_write(format_4d(keyball.last_mouse.h), false);
-    oled_write(format_4d(keyball.last_mouse.v), false);
+    oled_write(format_4d(clip4d(keyball.last_mouse.x)), false);
+    oled_write(format_4d(clip4d(keyball.last_mouse.y)), false);
+    oled_write(format_4d(clip4d(keyball.last_mouse.h)), false);
+    oled_write(format_4d(clip4d(keyball.last_mouse.v)), false);
 
     // 2nd line, empty label and CPI
     oled_write_P(PSTR("    \xB1\xBC\xBD"), false);
@@ -429,6 +1162,20 @@ void keyball_oled_render_ballinfo(void) {
 
 void keyball_oled_render_ballsubinfo(void) {
 #ifdef OLED_ENABLE
+    // Format: `Surf:{SQUAL avg}{SQUAL min}{shutter avg}{lifted count}`
+    //
+    // Output example:
+    //
+    //     Surf:  42  35 127   0
+    //
+    // All values are statistics in a last second, which are available only
+    // when PMW3360_BURST_TELEMETRY is defined.
+    pmw3360_surface_t s = pmw3360_surface_get();
+    oled_write_P(PSTR("Surf\xB1"), false);
+    oled_write(format_4d(s.squal_avg), false);
+    oled_write(format_4d(s.squal_min), false);
+    oled_write(format_4d(MIN(s.shutter_avg, 999)), false);
+    oled_write(format_4d(MIN(s.lifted, 999)), false);
 #endif
 }
 
@@ -508,6 +1255,8 @@ bool keyball_get_scroll_mode(void) {
 void keyball_set_scroll_mode(bool mode) {
     if (mode != keyball.scroll_mode) {
         keyball.scroll_mode_changed = timer_read32();
+        // a remainder of the other mode must not leak into this one.
+        memset(scroll_remains, 0, sizeof(scroll_remains));
     }
     keyball.scroll_mode = mode;
 }
@@ -538,6 +1287,34 @@ uint8_t keyball_get_cpi(void) {
     return keyball.cpi_value == 0 ? CPI_DEFAULT : keyball.cpi_value;
 }
 
+bool keyball_get_report_fast(void) {
+#ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+    return keyball.report_fast;
+#else
+    return false;
+#endif
+}
+
+void keyball_set_report_fast(bool enable) {
+#ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+    keyball.report_fast = enable;
+#endif
+}
+
+uint8_t keyball_get_accel_curve(void) {
+#ifdef KEYBALL_ACCEL_ENABLE
+    return keyball.accel_curve;
+#else
+    return 0;
+#endif
+}
+
+void keyball_set_accel_curve(uint8_t curve) {
+#ifdef KEYBALL_ACCEL_ENABLE
+    keyball.accel_curve = curve > 3 ? 3 : curve;
+#endif
+}
+
 void keyball_set_cpi(uint8_t cpi) {
     if (cpi > CPI_MAX) {
         cpi = CPI_MAX;
@@ -549,6 +1326,66 @@ void keyball_set_cpi(uint8_t cpi) {
     }
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Frame capture
+
+#ifdef KEYBALL_FRAME_CAPTURE_ENABLE
+
+// A host sends a packet which starts with KEYBALL_RAW_FRAME_CAPTURE, then
+// receives packets of the frame in this layout:
+//
+//     [0]     KEYBALL_RAW_FRAME_CAPTURE
+//     [1]     index of chunk, or 0xFF when capture is not available
+//     [2..31] pixels
+#    define FRAME_CHUNK_SIZE (RAW_EPSIZE - 2)
+
+static uint8_t frame_index = 0;
+
+static void frame_capture_request(uint8_t *data) {
+    if (!keyball.this_have_ball || !pmw3360_frame_capture_start()) {
+        data[1] = 0xff;
+        raw_hid_send(data, RAW_EPSIZE);
+        return;
+    }
+    frame_index = 0;
+}
+
+// frame_capture_task sends a chunk of the frame at most, so a scan loop is
+// delayed less than 1ms.
+static void frame_capture_task(void) {
+    if (!pmw3360_frame_capturing()) {
+        return;
+    }
+    uint8_t buf[RAW_EPSIZE] = {KEYBALL_RAW_FRAME_CAPTURE, frame_index};
+    if (pmw3360_frame_capture_read(buf + 2, FRAME_CHUNK_SIZE) == 0) {
+        return;
+    }
+    raw_hid_send(buf, RAW_EPSIZE);
+    frame_index++;
+    if (!pmw3360_frame_capturing()) {
+        // the sensor has been reset after the last pixel.
+        sensor_restart();
+    }
+}
+
+#    ifdef VIA_ENABLE
+bool via_command_kb(uint8_t *data, uint8_t length) {
+    if (data[0] != KEYBALL_RAW_FRAME_CAPTURE) {
+        return false;
+    }
+    frame_capture_request(data);
+    return true;
+}
+#    else
+void raw_hid_receive(uint8_t *data, uint8_t length) {
+    if (data[0] == KEYBALL_RAW_FRAME_CAPTURE) {
+        frame_capture_request(data);
+    }
+}
+#    endif
+
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 // Keyboard hooks
 
@@ -556,9 +1393,7 @@ void keyboard_post_init_kb(void) {
 #ifdef SPLIT_KEYBOARD
     // register transaction handlers on secondary.
     if (!is_keyboard_master()) {
-        transaction_register_rpc(KEYBALL_GET_INFO, rpc_get_info_handler);
-        transaction_register_rpc(KEYBALL_GET_MOTION, rpc_get_motion_handler);
-        transaction_register_rpc(KEYBALL_SET_CPI, rpc_set_cpi_handler);
+        transaction_register_rpc(KEYBALL_SYNC, rpc_sync_handler);
     }
 #endif
 
@@ -573,6 +1408,9 @@ void keyboard_post_init_kb(void) {
 #endif
 #if KEYBALL_SCROLLSNAP_ENABLE == 2
         keyball_set_scrollsnap_mode(c.ssnap);
+#endif
+#ifdef KEYBALL_ACCEL_ENABLE
+        keyball_set_accel_curve(c.accel);
 #endif
     }
 
@@ -580,17 +1418,42 @@ void keyboard_post_init_kb(void) {
     keyboard_post_init_user();
 }
 
-#if SPLIT_KEYBOARD
 void housekeeping_task_kb(void) {
+#if defined(KEYBALL_PMW3360_SROM)
+    srom_upload_task();
+#endif
+#ifdef SENSOR_WATCHDOG_ENABLE
+    sensor_watchdog_task();
+#endif
+#ifdef KEYBALL_FRAME_CAPTURE_ENABLE
+    frame_capture_task();
+#endif
+#ifdef SPLIT_KEYBOARD
     if (is_keyboard_master()) {
-        rpc_get_info_invoke();
-        if (keyball.that_have_ball) {
-            rpc_get_motion_invoke();
-            rpc_set_cpi_invoke();
-        }
+        rpc_sync_invoke();
+#    ifdef DEBUG_KEYBALL_TX_RATE
+        tx_rate_task();
+#    endif
+    } else {
+        cpi_apply();
+        suspend_apply(suspend_requested);
     }
+#endif
 }
+
+void suspend_power_down_kb(void) {
+    // this is called repeatedly while suspended, instead of housekeeping.
+    suspend_apply(true);
+#ifdef SPLIT_KEYBOARD
+    rpc_sync_invoke();
 #endif
+    suspend_power_down_user();
+}
+
+void suspend_wakeup_init_kb(void) {
+    suspend_apply(false);
+    suspend_wakeup_init_user();
+}
 
 static void pressing_keys_update(uint16_t keycode, keyrecord_t *record) {
     // Process only valid keycodes.
@@ -663,6 +1526,7 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
             case KBC_RST:
                 keyball_set_cpi(0);
                 keyball_set_scroll_div(0);
+                keyball_set_accel_curve(0);
 #ifdef POINTING_DEVICE_AUTO_MOUSE_ENABLE
                 set_auto_mouse_enable(false);
                 set_auto_mouse_timeout(AUTO_MOUSE_TIME);
@@ -678,6 +1542,9 @@ bool process_record_kb(uint16_t keycode, keyrecord_t *record) {
 #endif
 #if KEYBALL_SCROLLSNAP_ENABLE == 2
                     .ssnap = keyball_get_scrollsnap_mode(),
+#endif
+#ifdef KEYBALL_ACCEL_ENABLE
+                    .accel = keyball_get_accel_curve(),
 #endif
                 };
                 eeconfig_update_kb(c.raw);
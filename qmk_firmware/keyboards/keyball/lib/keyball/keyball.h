@@ -32,6 +32,123 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #    define KEYBALL_REPORTMOUSE_INTERVAL 8 // mouse report rate: 125Hz
 #endif
 
+/// Mouse reports are sent every KEYBALL_REPORTMOUSE_INTERVAL ms on a fixed
+/// grid of time, so the interval doesn't drift with the scan loop.
+/// Define DEBUG_KEYBALL_REPORT_JITTER with CONSOLE_ENABLE to log statistics
+/// of intervals between reports every second.
+//#define DEBUG_KEYBALL_REPORT_JITTER
+
+/// Define KEYBALL_REPORTMOUSE_FAST_INTERVAL to enable adaptive report rate.
+/// Mouse reports are sent every KEYBALL_REPORTMOUSE_FAST_INTERVAL ms while
+/// the ball is moving, and back to KEYBALL_REPORTMOUSE_INTERVAL after
+/// KEYBALL_REPORTMOUSE_FAST_TIMEOUT ms without motion.  Polling the sensor and
+/// motion of the other half are quickened as well.  It can be toggled at
+/// runtime by keyball_set_report_fast().
+///
+/// The host polls the mouse endpoint every USB_POLLING_INTERVAL_MS of QMK
+/// (1ms by default), so it shouldn't be longer than the fast interval.
+//#define KEYBALL_REPORTMOUSE_FAST_INTERVAL 1
+
+#ifndef KEYBALL_REPORTMOUSE_FAST_TIMEOUT
+#    define KEYBALL_REPORTMOUSE_FAST_TIMEOUT 100
+#endif
+
+#if defined(KEYBALL_REPORTMOUSE_FAST_INTERVAL) && defined(USB_POLLING_INTERVAL_MS) && USB_POLLING_INTERVAL_MS > KEYBALL_REPORTMOUSE_FAST_INTERVAL
+#    error USB_POLLING_INTERVAL_MS should not be longer than KEYBALL_REPORTMOUSE_FAST_INTERVAL.
+#endif
+
+/// Secondary raises a "motion pending" bit in its key matrix while it has
+/// motion not sent yet, which is carried to primary by regular matrix sync.
+/// Primary fetches motion by KEYBALL_SYNC only when the bit is set, so
+/// no transactions are spent for an idle ball.  The bit is the top bit of the
+/// first row of each half, which must be masked by matrix_mask.  Define this
+/// as 0 to fetch motion every KEYBALL_TX_GETMOTION_INTERVAL ms instead.
+#ifndef KEYBALL_TX_MOTION_PENDING
+#    define KEYBALL_TX_MOTION_PENDING 1
+#endif
+
+/// Define DEBUG_KEYBALL_TX_RATE with CONSOLE_ENABLE to log the count of
+/// KEYBALL_SYNC transactions every second.
+//#define DEBUG_KEYBALL_TX_RATE
+
+/// Define MOUSE_EXTENDED_REPORT in your config.h to send 16-bit X and Y of
+/// mouse reports instead of 8-bit, which avoids saturation at high CPI.  It
+/// costs 2 bytes per report.
+//#define MOUSE_EXTENDED_REPORT
+
+/// Motion beyond the range of a mouse report is carried over to next reports.
+/// Define this macro to send reports back-to-back, regardless of
+/// KEYBALL_REPORTMOUSE_INTERVAL, while reports are saturated by a fast flick.
+//#define KEYBALL_REPORTMOUSE_DRAIN
+
+/// Define this macro to enable pointer acceleration.  Movement of a report
+/// is multiplied by a gain, which is looked up by speed of the report from a
+/// table of Q8.8 fixed point values.  The tables are generated by compiler
+/// from KEYBALL_ACCEL_CURVE1 to 3, so neither float nor division is used at
+/// runtime.  Curve 0 means no acceleration.  See keyball_set_accel_curve()
+/// and keyball_on_select_accel_curve().
+//#define KEYBALL_ACCEL_ENABLE
+
+/// Acceleration curves in form of "OFFSET, SLOPE, LIMIT".  The gain is 1.0
+/// (256) up to speed OFFSET, increases by SLOPE/256 per count of speed, and
+/// is limited to LIMIT/256.  Speed is approximate length of motion in a
+/// report, in counts of the sensor.  Reports at
+/// KEYBALL_REPORTMOUSE_FAST_INTERVAL are scaled to the speed in
+/// KEYBALL_REPORTMOUSE_INTERVAL, so the curves don't depend on report rate.
+#ifndef KEYBALL_ACCEL_CURVE1
+#    define KEYBALL_ACCEL_CURVE1 8, 4, 384 // mild: up to x1.5
+#endif
+#ifndef KEYBALL_ACCEL_CURVE2
+#    define KEYBALL_ACCEL_CURVE2 8, 8, 512 // medium: up to x2.0
+#endif
+#ifndef KEYBALL_ACCEL_CURVE3
+#    define KEYBALL_ACCEL_CURVE3 4, 16, 768 // strong: up to x3.0
+#endif
+
+/// Speed is quantized by 2^KEYBALL_ACCEL_SPEED_SHIFT counts to look up 16
+/// steps of the tables.  The default covers speed up to 127.
+#ifndef KEYBALL_ACCEL_SPEED_SHIFT
+#    define KEYBALL_ACCEL_SPEED_SHIFT 3
+#endif
+
+/// Specify a motion filter for each ball by its side, to suppress jitter of
+/// the sensor at rest.  A filter is applied to each motion burst by the half
+/// which has the ball.  Available filters:
+///
+///   KEYBALL_FILTER_NONE     - no filter (default).
+///   KEYBALL_FILTER_DEADZONE - ignore motion within
+///                             KEYBALL_FILTER_DEADZONE_COUNTS at rest.  It is
+///                             at rest again after no motion in
+///                             KEYBALL_FILTER_DEADZONE_TIMEOUT ms.
+///   KEYBALL_FILTER_EMA      - exponential moving average with factor 1/2.
+///                             Unreported motion is carried over, and
+///                             released when bursts stop at rest.
+///   KEYBALL_FILTER_MEDIAN   - median of the last 3 bursts, to spread
+///                             spikes.  The rest of motion is carried over,
+///                             and released by half every burst.
+///
+/// EMA and MEDIAN hold back part of motion until later bursts, or until 2ms
+/// after bursts stop at rest, so all motion is reported a report later at
+/// most.  DEADZONE doesn't delay motion, but drops small motion at rest.
+#define KEYBALL_FILTER_NONE 0
+#define KEYBALL_FILTER_DEADZONE 1
+#define KEYBALL_FILTER_EMA 2
+#define KEYBALL_FILTER_MEDIAN 3
+
+#ifndef KEYBALL_FILTER_LEFT
+#    define KEYBALL_FILTER_LEFT KEYBALL_FILTER_NONE
+#endif
+#ifndef KEYBALL_FILTER_RIGHT
+#    define KEYBALL_FILTER_RIGHT KEYBALL_FILTER_NONE
+#endif
+
+#ifndef KEYBALL_FILTER_DEADZONE_COUNTS
+#    define KEYBALL_FILTER_DEADZONE_COUNTS 1
+#endif
+#ifndef KEYBALL_FILTER_DEADZONE_TIMEOUT
+#    define KEYBALL_FILTER_DEADZONE_TIMEOUT 100
+#endif
+
 #ifndef KEYBALL_SCROLLBALL_INHIVITOR
 #    define KEYBALL_SCROLLBALL_INHIVITOR 50
 #endif
@@ -53,9 +170,54 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /// enabled high CPI setting or so.  Valid valus are 0x04 or 0x81.  Define this
 /// in your config.h to be enable.  Please note that using this option will
 /// increase the firmware size by more than 4KB.
+///
+/// SROM images are not compressed: they are almost random (zlib saves only 4%
+/// to 8%, LZ with a small RAM window makes them larger), so a decompressor
+/// would cost more flash than it saves.
 //#define KEYBALL_PMW3360_UPLOAD_SROM_ID 0x04
 //#define KEYBALL_PMW3360_UPLOAD_SROM_ID 0x81
 
+/// Defining this macro defers SROM upload until USB has been configured, so
+/// keys work immediately after plug-in.  The trackball works with stock
+/// firmware of the sensor until SROM is uploaded chunk by chunk in
+/// housekeeping task, then CPI is restored.
+//#define KEYBALL_PMW3360_DEFER_SROM_UPLOAD
+
+/// Specify power profile of PMW3360DM (optical sensor) in your config.h.
+/// Valid values are pmw3360_POWER_LATENCY (default), pmw3360_POWER_BALANCED
+/// or pmw3360_POWER_SAVING.  See pmw3360_power_t for details.  Regardless of
+/// this, pmw3360_POWER_SAVING is used while USB is suspended, on both halves.
+#ifndef KEYBALL_PMW3360_POWER_PROFILE
+#    define KEYBALL_PMW3360_POWER_PROFILE pmw3360_POWER_LATENCY
+#endif
+
+/// Specify interval in milliseconds to validate PMW3360DM (optical sensor)
+/// by Product_ID and Inverse_Product_ID.  When the validation fails, the
+/// sensor is re-initialized with SROM upload and CPI in housekeeping task,
+/// without blocking key scan.  The sensor is probed also on a half without
+/// ball, so the ball module can be attached or detached without reboot.
+/// Each validation blocks for about 0.4ms with two register reads, and
+/// exits motion burst mode.  1000 is a good value to enable it.  Primary also
+/// re-negotiates with secondary every second then, to find hot-plug there.
+/// Default is 0, which disables the watchdog and hot-plug.
+#ifndef KEYBALL_SENSOR_WATCHDOG_INTERVAL
+#    define KEYBALL_SENSOR_WATCHDOG_INTERVAL 0
+#endif
+
+/// Motion of a burst larger than this is impossible for a hand, and is
+/// discarded.  Three of them in a row trigger the validation immediately.
+/// This works only when KEYBALL_SENSOR_WATCHDOG_INTERVAL is not 0.
+#ifndef KEYBALL_SENSOR_WATCHDOG_MAXDELTA
+#    define KEYBALL_SENSOR_WATCHDOG_MAXDELTA 4000
+#endif
+
+/// Define this macro to enable raw frame capture of PMW3360DM over raw HID,
+/// to diagnose tracking (dust, a scratched lens, etc).  It requires
+/// RAW_ENABLE or VIA_ENABLE in rules.mk.  Only the sensor of the half which is
+/// connected to USB can be captured.  Use bin/keyball-frame.py to save a
+/// captured frame as a PGM image.
+//#define KEYBALL_FRAME_CAPTURE_ENABLE
+
 /// Defining this macro keeps two functions intact: keycode_config() and
 /// mod_config() in keycode_config.c.
 ///
@@ -70,8 +232,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define KEYBALL_TX_GETINFO_INTERVAL 500
 #define KEYBALL_TX_GETINFO_MAXTRY 10
+#define KEYBALL_TX_GETINFO_RENEGOTIATE_INTERVAL 1000
 #define KEYBALL_TX_GETMOTION_INTERVAL 4
 
+// Command ID of raw HID packet for frame capture, which doesn't conflict with
+// VIA's command IDs.
+#define KEYBALL_RAW_FRAME_CAPTURE 0x46
+
 #if (PRODUCT_ID & 0xff00) == 0x0000
 #    define KEYBALL_MODEL 46
 #elif (PRODUCT_ID & 0xff00) == 0x0100
@@ -130,14 +297,13 @@ typedef union {
 #endif
 #if KEYBALL_SCROLLSNAP_ENABLE == 2
         uint8_t ssnap : 2; // scroll snap mode
+#endif
+#ifdef KEYBALL_ACCEL_ENABLE
+        uint8_t accel : 2; // acceleration curve
 #endif
     };
 } keyball_config_t;
 
-typedef struct {
-    uint8_t ballcnt; // count of balls: support only 0 or 1, for now
-} keyball_info_t;
-
 typedef struct {
     int16_t x;
     int16_t y;
@@ -145,6 +311,20 @@ typedef struct {
 
 typedef uint8_t keyball_cpi_t;
 
+typedef struct {
+    keyball_cpi_t    cpi;        // CPI of trackball, applied by secondary when changed
+    bool             suspended;  // USB is suspended, secondary saves power too
+    bool             base_known; // primary has taken a base since it started
+    keyball_motion_t base;       // totals of motion which primary has applied
+} keyball_sync_request_t;
+
+typedef struct {
+    uint8_t          ballcnt;    // count of balls: support only 0 or 1, for now
+    uint8_t          recoveries; // count of sensor recoveries, wraps around
+    bool             fresh;      // either half has been reset, totals are a new base
+    keyball_motion_t totals;     // running totals of motion, wrap around
+} keyball_sync_reply_t;
+
 typedef enum {
     KEYBALL_SCROLLSNAP_MODE_VERTICAL   = 0,
     KEYBALL_SCROLLSNAP_MODE_HORIZONTAL = 1,
@@ -162,6 +342,18 @@ typedef struct {
     uint8_t cpi_value;
     bool    cpi_changed;
 
+    // Counters of sensor watchdog.
+    uint16_t this_sensor_failures;    // count of failed validations
+    uint16_t this_sensor_recoveries;  // count of completed recoveries
+    uint16_t this_sensor_recovery_ms; // time which the last recovery took
+    uint8_t  that_sensor_recoveries;  // count reported by the other half
+
+#ifdef KEYBALL_REPORTMOUSE_FAST_INTERVAL
+    bool     report_fast;     // adaptive report rate is enabled
+    uint32_t motion_last;     // last time when either ball moved
+    uint8_t  report_interval; // interval of the current report in ms
+#endif
+
     bool     scroll_mode;
     uint32_t scroll_mode_changed;
     uint8_t  scroll_div;
@@ -173,6 +365,10 @@ typedef struct {
     keyball_scrollsnap_mode_t scrollsnap_mode;
 #endif
 
+#ifdef KEYBALL_ACCEL_ENABLE
+    uint8_t accel_curve;
+#endif
+
     uint16_t       last_kc;
     keypos_t       last_pos;
     report_mouse_t last_mouse;
@@ -199,7 +395,9 @@ extern keyball_t keyball;
 void keyball_on_adjust_layout(keyball_adjust_t v);
 
 /// keyball_on_apply_motion_to_mouse_move applies trackball's motion m to r as
-/// mouse movement.
+/// mouse movement.  It is not called when m has no motion.
+/// It should subtract reported motion from m, then the rest of m is carried
+/// over to next reports.
 /// You can change the default algorithm by override this function.
 void keyball_on_apply_motion_to_mouse_move(keyball_motion_t *m, report_mouse_t *r, bool is_left);
 
@@ -208,6 +406,18 @@ void keyball_on_apply_motion_to_mouse_move(keyball_motion_t *m, report_mouse_t *
 /// You can change the default algorithm by override this function.
 void keyball_on_apply_motion_to_mouse_scroll(keyball_motion_t *m, report_mouse_t *r, bool is_left);
 
+/// keyball_on_select_accel_curve selects an acceleration curve to apply to
+/// mouse movement.  curve is the value of keyball_get_accel_curve().  The
+/// result is limited to 3.
+/// You can select a curve for each layer by override this function, like:
+///
+///     uint8_t keyball_on_select_accel_curve(uint8_t curve) {
+///         return layer_state_is(3) ? 0 : curve;
+///     }
+///
+/// This works only when KEYBALL_ACCEL_ENABLE is defined.
+uint8_t keyball_on_select_accel_curve(uint8_t curve);
+
 //////////////////////////////////////////////////////////////////////////////
 // Public API functions
 
@@ -215,6 +425,11 @@ void keyball_on_apply_motion_to_mouse_scroll(keyball_motion_t *m, report_mouse_t
 /// It uses just 21 columns to show the info.
 void keyball_oled_render_ballinfo(void);
 
+/// keyball_oled_render_ballsubinfo renders surface quality statistics of the
+/// trackball sensor to OLED.  It uses just 21 columns to show the info.
+/// Define PMW3360_BURST_TELEMETRY to collect the statistics.
+void keyball_oled_render_ballsubinfo(void);
+
 /// keyball_get_state_label returns a short label shown by keyball_oled_render_ballinfo.
 /// Override this in your keymap to display custom state text.
 const char *keyball_get_state_label(void);
@@ -257,6 +472,13 @@ uint8_t keyball_get_scroll_div(void);
 ///
 /// Valid values are between 1 and 7, KEYBALL_SCROLL_DIV_DEFAULT is used when 0
 /// is specified.
+///
+/// The remainder of the division is carried over to next reports.
+///
+/// Scroll is reported in whole wheel detents.  High resolution scroll by HID
+/// Resolution Multiplier is not supported: QMK 0.22.14, which Keyball builds
+/// with, has neither the descriptor nor its feature report, and a keyboard
+/// can't add them without patching the core.
 void keyball_set_scroll_div(uint8_t div);
 
 /// keyball_get_cpi gets current CPI of trackball.
@@ -274,3 +496,21 @@ uint8_t keyball_get_cpi(void);
 /// In addition, if you do not upload SROM, the maximum value will be limited
 /// to 35 (3500CPI).
 void keyball_set_cpi(uint8_t cpi);
+
+/// keyball_get_report_fast gets whether adaptive report rate is enabled.
+/// This works only when KEYBALL_REPORTMOUSE_FAST_INTERVAL is defined,
+/// otherwise returns false.
+bool keyball_get_report_fast(void);
+
+/// keyball_set_report_fast enables or disables adaptive report rate.  When
+/// disabled, mouse reports are sent every KEYBALL_REPORTMOUSE_INTERVAL ms
+/// always.  It is enabled at boot.
+void keyball_set_report_fast(bool enable);
+
+/// keyball_get_accel_curve gets current acceleration curve: 0 to 3.
+/// This works only when KEYBALL_ACCEL_ENABLE is defined, otherwise returns 0.
+uint8_t keyball_get_accel_curve(void);
+
+/// keyball_set_accel_curve changes acceleration curve.  Valid values are 0
+/// (no acceleration) to 3.  It is saved to EEPROM by KBC_SAVE.
+void keyball_set_accel_curve(uint8_t curve);
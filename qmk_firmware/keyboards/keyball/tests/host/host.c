@@ -0,0 +1,133 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host implementation of QMK functions which the driver and keyball.c use.
+
+#include <string.h>
+#include "quantum.h"
+#include "transactions.h"
+#include "usb_device_state.h"
+#include "host.h"
+#include "../pmw3360_sim.h"
+
+uint64_t host_us     = 0;
+bool     host_master = true;
+bool     host_left   = false;
+
+host_rpc_handler_t host_rpc_handler = NULL;
+bool (*host_rpc_exec)(int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data) = NULL;
+
+matrix_row_t          matrix[MATRIX_ROWS];
+enum usb_device_state usb_device_state = USB_DEVICE_STATE_CONFIGURED;
+
+void host_advance_us(uint32_t us) {
+    host_us += us;
+}
+
+// Reading timer costs 1us, so busy loops on timer advance simulated time.
+uint32_t timer_read32(void) {
+    host_us++;
+    return host_us / 1000;
+}
+
+void wait_us(uint16_t us) {
+    host_us += us;
+}
+
+void wait_ms(uint16_t ms) {
+    host_us += (uint64_t)ms * 1000;
+}
+
+void setPinOutput(pin_t pin) {}
+
+void setPinInputHigh(pin_t pin) {}
+
+bool readPin(pin_t pin) {
+    if (sim.motion_pin != 0 && pin == sim.motion_pin) {
+        return sim_motion_pin_read();
+    }
+    return true;
+}
+
+bool is_keyboard_master(void) {
+    return host_master;
+}
+
+bool is_keyboard_left(void) {
+    return host_left;
+}
+
+static uint32_t eeconfig_kb = 0;
+
+bool eeconfig_is_enabled(void) {
+    return true;
+}
+
+uint32_t eeconfig_read_kb(void) {
+    return eeconfig_kb;
+}
+
+void eeconfig_update_kb(uint32_t val) {
+    eeconfig_kb = val;
+}
+
+bool layer_state_is(uint8_t layer) {
+    return layer == 0;
+}
+
+__attribute__((weak)) void keyboard_pre_init_user(void) {}
+__attribute__((weak)) void keyboard_post_init_user(void) {}
+__attribute__((weak)) void suspend_power_down_user(void) {}
+__attribute__((weak)) void suspend_wakeup_init_user(void) {}
+__attribute__((weak)) void matrix_slave_scan_user(void) {}
+
+__attribute__((weak)) bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    return true;
+}
+
+void oled_write(const char *data, bool invert) {}
+void oled_write_P(const char *data, bool invert) {}
+void oled_write_char(char data, bool invert) {}
+
+static uint32_t via_layout = 0;
+
+uint32_t via_get_layout_options(void) {
+    return via_layout;
+}
+
+void via_set_layout_options(uint32_t value) {
+    via_layout = value;
+}
+
+bool transaction_rpc_exec(int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data) {
+    if (host_rpc_exec) {
+        return host_rpc_exec(id, in_len, in_data, out_len, out_data);
+    }
+    if (!host_rpc_handler) {
+        return false;
+    }
+    host_rpc_handler(in_len, in_data, out_len, out_data);
+    return true;
+}
+
+void transaction_register_rpc(int8_t id, slave_callback_t callback) {
+    host_rpc_handler = callback;
+}
+
+void raw_hid_send(uint8_t *data, uint8_t length) {}
+
+void register_mouse(uint8_t mouse_keycode, bool pressed) {}
@@ -0,0 +1,43 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Controls of the host environment for tests, which stand in for the other
+// half of split keyboard, USB host and so on.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "quantum.h"
+
+extern uint64_t host_us;
+extern bool     host_master;
+extern bool     host_left;
+
+typedef void (*host_rpc_handler_t)(uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data);
+
+/// host_rpc_handler is registered by transaction_register_rpc().
+extern host_rpc_handler_t host_rpc_handler;
+
+/// host_rpc_exec serves transaction_rpc_exec() when set.  Otherwise it calls
+/// host_rpc_handler directly, like a lossless link.
+extern bool (*host_rpc_exec)(int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data);
+
+extern matrix_row_t matrix[MATRIX_ROWS];
+
+/// host_advance_us advances simulated time without any other effect.
+void host_advance_us(uint32_t us);
@@ -0,0 +1,160 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Minimal subset of QMK for host tests.  Time is simulated: wait_us() and
+// SPI transfers advance host_us, and timer_read32() reads it in ms.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifndef F_CPU
+#    define F_CPU 16000000
+#endif
+
+#define PROGMEM
+#define PSTR(s) s
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#ifndef MIN
+#    define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#    define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define TIMER_DIFF_32(a, b) ((uint32_t)((a) - (b)))
+
+#ifdef HOST_DEBUG
+#    define dprintf(...) fprintf(stderr, __VA_ARGS__)
+#else
+#    define dprintf(...) \
+        do {             \
+        } while (0)
+#endif
+
+// pins
+typedef uint8_t pin_t;
+#define B5 0x15
+#define B6 0x16
+#define D0 0x30
+#define D1 0x31
+
+void setPinOutput(pin_t pin);
+void setPinInputHigh(pin_t pin);
+bool readPin(pin_t pin);
+
+// simulated time
+extern uint64_t host_us;
+uint32_t        timer_read32(void);
+void            wait_us(uint16_t us);
+void            wait_ms(uint16_t ms);
+
+// keyboard
+#ifndef PRODUCT_ID
+#    define PRODUCT_ID 0x0400
+#endif
+#ifndef MATRIX_ROWS
+#    define MATRIX_ROWS 8
+#endif
+#ifndef MATRIX_COLS
+#    define MATRIX_COLS 6
+#endif
+
+typedef uint8_t matrix_row_t;
+
+typedef struct {
+    uint8_t col;
+    uint8_t row;
+} keypos_t;
+
+typedef struct {
+    keypos_t key;
+    bool     pressed;
+    uint16_t time;
+} keyevent_t;
+
+typedef struct {
+    keyevent_t event;
+} keyrecord_t;
+
+#define QK_KB_0 0x7E00
+#define QK_KB_1 0x7E01
+#define QK_KB_2 0x7E02
+#define QK_KB_3 0x7E03
+#define QK_KB_4 0x7E04
+#define QK_KB_5 0x7E05
+#define QK_KB_6 0x7E06
+#define QK_KB_7 0x7E07
+#define QK_KB_8 0x7E08
+#define QK_KB_9 0x7E09
+#define QK_KB_10 0x7E0A
+#define QK_KB_11 0x7E0B
+#define QK_KB_12 0x7E0C
+#define QK_KB_13 0x7E0D
+#define QK_KB_14 0x7E0E
+#define QK_KB_15 0x7E0F
+#define QK_USER_0 0x7E40
+#define QK_MODS 0x0100
+#define QK_MODS_MAX 0x1FFF
+#define KC_MS_BTN1 0x00D1
+#define KC_MS_BTN8 0x00D8
+
+// mouse report
+#ifdef MOUSE_EXTENDED_REPORT
+typedef int16_t mouse_xy_report_t;
+#else
+typedef int8_t mouse_xy_report_t;
+#endif
+#ifdef WHEEL_EXTENDED_REPORT
+typedef int16_t mouse_hv_report_t;
+#else
+typedef int8_t mouse_hv_report_t;
+#endif
+
+typedef struct {
+    uint8_t           buttons;
+    mouse_xy_report_t x;
+    mouse_xy_report_t y;
+    mouse_hv_report_t v;
+    mouse_hv_report_t h;
+} report_mouse_t;
+
+bool     is_keyboard_master(void);
+bool     is_keyboard_left(void);
+bool     eeconfig_is_enabled(void);
+uint32_t eeconfig_read_kb(void);
+void     eeconfig_update_kb(uint32_t val);
+bool     layer_state_is(uint8_t layer);
+void     keyboard_pre_init_user(void);
+void     keyboard_post_init_user(void);
+void     suspend_power_down_user(void);
+void     suspend_wakeup_init_user(void);
+bool     process_record_user(uint16_t keycode, keyrecord_t *record);
+void     matrix_slave_scan_user(void);
+
+void oled_write(const char *data, bool invert);
+void oled_write_P(const char *data, bool invert);
+void oled_write_char(char data, bool invert);
+
+uint32_t via_get_layout_options(void);
+void     via_set_layout_options(uint32_t value);
@@ -0,0 +1,32 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Fake split transactions of QMK for host tests.  See host.h.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum {
+    KEYBALL_SYNC = 0,
+};
+
+typedef void (*slave_callback_t)(uint8_t in_buflen, const void *in_data, uint8_t out_buflen, void *out_data);
+
+bool transaction_rpc_exec(int8_t transaction_id, uint8_t initiator2target_buflen, const void *initiator2target_buf, uint8_t target2initiator_buflen, void *target2initiator_buf);
+void transaction_register_rpc(int8_t transaction_id, slave_callback_t callback);
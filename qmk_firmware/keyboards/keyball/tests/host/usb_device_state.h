@@ -0,0 +1,27 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+enum usb_device_state {
+    USB_DEVICE_STATE_NO_INIT    = 0,
+    USB_DEVICE_STATE_INIT       = 1,
+    USB_DEVICE_STATE_CONFIGURED = 2,
+    USB_DEVICE_STATE_SUSPEND    = 3,
+};
+
+extern enum usb_device_state usb_device_state;
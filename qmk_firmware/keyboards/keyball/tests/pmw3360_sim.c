@@ -0,0 +1,523 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include "quantum.h"
+#include "spi_master.h"
+#include "drivers/pmw3360/pmw3360.h"
+#include "pmw3360_sim.h"
+
+pmw3360_sim_t sim;
+
+// SPI timings in datasheet, in microseconds.  Sub-microsecond ones are
+// rounded up to 1us, as the driver does.
+#define SIM_SRAD 160         // read address to data
+#define SIM_SRAD_MOTBR 35    // Motion_Burst address to data
+#define SIM_SCLK_NCS_W 35    // last SCLK to NCS high after write
+#define SIM_SRW_SRR 20       // read to next read or write
+#define SIM_SWW_SWR 180      // write to next write or read
+#define SIM_SROM_BYTE 15     // spacing of SROM bytes
+#define SIM_SROM_LOAD 200    // after SROM download
+#define SIM_CRC 10000        // SROM CRC self-test
+#define SIM_RESET 50000      // after Power_Up_Reset
+#define SIM_FRAME 20000      // Frame_Capture to Raw_Data_Burst
+#define SIM_PIXEL 15         // spacing of Raw_Data_Burst bytes
+#define SIM_BYTE_US 4        // a byte at 2MHz
+
+typedef enum {
+    PHASE_ADDR = 0, // NCS is low, waiting address
+    PHASE_WDATA,    // waiting data to write
+    PHASE_RDATA,    // waiting to read data
+    PHASE_BURST,    // reading Motion_Burst
+    PHASE_SROM,     // writing SROM_Load_Burst
+    PHASE_RAW,      // reading Raw_Data_Burst
+    PHASE_DONE,     // transaction is done, waiting NCS high
+} phase_t;
+
+static struct {
+    bool        ncs_low;
+    phase_t     phase;
+    bool        write;
+    uint8_t     addr;
+    uint64_t    ncs_fall;
+    uint64_t    addr_start;
+    uint64_t    addr_end;
+    uint64_t    data_end;
+    uint64_t    last_byte;
+    uint64_t    next_ok;   // the earliest time for the next address
+    const char *next_rule; // name of timing for next_ok
+    uint8_t     burst[12];
+    uint8_t     burst_index;
+    uint16_t    index;
+    uint8_t     srom[4096];
+    bool        srom_spacing_bad;
+    bool        srom_enabled; // 0x1d then 0x18 has been written to SROM_Enable
+    bool        srom_loaded;  // a valid SROM image is loaded
+    uint64_t    crc_start;
+    bool        crc_running;
+    bool        frame_armed; // 0x83 has been written to Frame_Capture
+    bool        capturing;
+    uint64_t    capture_start;
+} bus;
+
+static void violation(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(sim.last_violation, sizeof(sim.last_violation), fmt, ap);
+    va_end(ap);
+    sim.violations++;
+    if (sim.quiet) {
+        return;
+    }
+    fprintf(stderr, "pmw3360_sim: %llu us: %s\n", (unsigned long long)host_us, sim.last_violation);
+}
+
+uint32_t sim_violations_take(void) {
+    uint32_t n     = sim.violations;
+    sim.violations = 0;
+    return n;
+}
+
+// chip_reset loads default values of registers, like Power_Up_Reset.
+static void chip_reset(void) {
+    memset(sim.regs, 0, sizeof(sim.regs));
+    sim.regs[pmw3360_Product_ID]         = 0x42;
+    sim.regs[pmw3360_Revision_ID]        = 0x01;
+    sim.regs[pmw3360_Config1]            = 0x31;
+    sim.regs[pmw3360_Config2]            = 0x20;
+    sim.regs[pmw3360_Run_Downshift]      = 0x32;
+    sim.regs[pmw3360_Rest1_Downshift]    = 0x1F;
+    sim.regs[pmw3360_Rest2_Rate_Lower]   = 0x63;
+    sim.regs[pmw3360_Rest2_Downshift]    = 0xBC;
+    sim.regs[pmw3360_Rest3_Rate_Lower]   = 0xF3;
+    sim.regs[pmw3360_Rest3_Rate_Upper]   = 0x01;
+    sim.regs[pmw3360_Inverse_Product_ID] = 0xBD;
+    sim.regs[pmw3360_Lift_Config]        = 0x02;
+    sim.burst_mode                       = false;
+    sim.navigating                       = true;
+    sim.srom_id                          = 0;
+    sim.dx                               = 0;
+    sim.dy                               = 0;
+    bus.srom_enabled                     = false;
+    bus.srom_loaded                      = false;
+    bus.crc_running                      = false;
+    bus.frame_armed                      = false;
+    bus.capturing                        = false;
+}
+
+void sim_power_on(void) {
+    memset(&sim, 0, sizeof(sim));
+    memset(&bus, 0, sizeof(bus));
+    chip_reset();
+}
+
+void sim_move(int16_t dx, int16_t dy) {
+    if (!sim.navigating || (dx == 0 && dy == 0)) {
+        return;
+    }
+    sim.dx += dx;
+    sim.dy += dy;
+    sim.last_motion = host_us;
+}
+
+static uint16_t rest_rate_ms(uint8_t lower) {
+    return (sim.regs[lower] | (sim.regs[lower + 1] << 8)) + 1;
+}
+
+uint8_t sim_op_mode(void) {
+    if (!(sim.regs[pmw3360_Config2] & 0x20)) {
+        return 0;
+    }
+    uint64_t idle = (host_us - sim.last_motion) / 1000;
+    uint64_t run  = sim.regs[pmw3360_Run_Downshift] * 10;
+    if (idle < run) {
+        return 0;
+    }
+    idle -= run;
+    uint64_t rest1 = (uint64_t)sim.regs[pmw3360_Rest1_Downshift] * 320 * rest_rate_ms(pmw3360_Rest1_Rate_Lower);
+    if (idle < rest1) {
+        return 1;
+    }
+    idle -= rest1;
+    uint64_t rest2 = (uint64_t)sim.regs[pmw3360_Rest2_Downshift] * 32 * rest_rate_ms(pmw3360_Rest2_Rate_Lower);
+    return idle < rest2 ? 2 : 3;
+}
+
+static bool motion_pending(void) {
+    return sim.navigating && (sim.dx != 0 || sim.dy != 0);
+}
+
+bool sim_motion_pin_read(void) {
+    return !motion_pending();
+}
+
+static int16_t take(int32_t *v) {
+    int32_t d = *v;
+    if (d > INT16_MAX) {
+        d = INT16_MAX;
+    } else if (d < INT16_MIN) {
+        d = INT16_MIN;
+    }
+    *v -= d;
+    return d;
+}
+
+// motion_latch latches pending motion into Motion and Delta registers.
+static void motion_latch(void) {
+    bool    mot = motion_pending();
+    int16_t x   = take(&sim.dx);
+    int16_t y   = take(&sim.dy);
+    sim.regs[pmw3360_Motion]    = (mot ? 0x80 : 0x00) | (sim_op_mode() << 1);
+    sim.regs[pmw3360_Delta_X_L] = x & 0xff;
+    sim.regs[pmw3360_Delta_X_H] = (x >> 8) & 0xff;
+    sim.regs[pmw3360_Delta_Y_L] = y & 0xff;
+    sim.regs[pmw3360_Delta_Y_H] = (y >> 8) & 0xff;
+}
+
+static void burst_latch(void) {
+    motion_latch();
+    for (uint8_t i = 0; i < 5; i++) {
+        bus.burst[i == 0 ? 0 : i + 1] = sim.regs[pmw3360_Motion + i];
+    }
+    bus.burst[1]  = 0; // Observation
+    bus.burst[6]  = 0x40;
+    bus.burst[7]  = 0x20;
+    bus.burst[8]  = 0x40;
+    bus.burst[9]  = 0x10;
+    bus.burst[10] = 0x00;
+    bus.burst[11] = 0x80;
+}
+
+static uint8_t reg_read(uint8_t addr) {
+    switch (addr) {
+        case pmw3360_Motion:
+            motion_latch();
+            break;
+        case pmw3360_SROM_ID:
+            return sim.srom_id;
+        case pmw3360_Data_Out_Lower:
+        case pmw3360_Data_Out_Upper:
+            if (!bus.crc_running) {
+                return 0;
+            }
+            if (host_us - bus.crc_start < SIM_CRC) {
+                violation("SROM CRC result is read %llu us after start", (unsigned long long)(host_us - bus.crc_start));
+                return 0;
+            }
+            if (addr == pmw3360_Data_Out_Lower) {
+                return bus.srom_loaded && sim.srom_corrupt == 0 ? 0xEF : 0x00;
+            }
+            if (sim.srom_corrupt > 0) {
+                sim.srom_corrupt--;
+                return 0x00;
+            }
+            return bus.srom_loaded ? 0xBE : 0x00;
+    }
+    return sim.regs[addr];
+}
+
+static void reg_write(uint8_t addr, uint8_t data) {
+    switch (addr) {
+        case pmw3360_Power_Up_Reset:
+            if (data == 0x5a) {
+                chip_reset();
+                sim.resets++;
+            }
+            return;
+        case pmw3360_Motion_Burst:
+            sim.burst_mode = true;
+            return;
+        case pmw3360_SROM_Enable:
+            if (data == 0x1d) {
+                if (sim.regs[pmw3360_Config2] & 0x20) {
+                    violation("SROM download with Rest_En");
+                }
+                bus.srom_enabled = false;
+                bus.crc_running  = false;
+            } else if (data == 0x18) {
+                bus.srom_enabled = sim.regs[addr] == 0x1d;
+            } else if (data == 0x15) {
+                bus.crc_running = true;
+                bus.crc_start   = host_us;
+            }
+            sim.regs[addr] = data;
+            return;
+        case pmw3360_Frame_Capture:
+            if (data == 0x83) {
+                bus.frame_armed = true;
+            } else if (data == 0xc5 && bus.frame_armed) {
+                if (sim.regs[pmw3360_Config2] & 0x20) {
+                    violation("frame capture with Rest_En");
+                }
+                // Frame capture overwrites SROM in RAM, and stops navigation
+                // until Power_Up_Reset.
+                bus.frame_armed   = false;
+                bus.capturing     = true;
+                bus.capture_start = host_us;
+                bus.srom_loaded   = false;
+                sim.srom_id       = 0;
+                sim.navigating    = false;
+                sim.dx            = 0;
+                sim.dy            = 0;
+            }
+            return;
+    }
+    sim.regs[addr] = data;
+}
+
+// srom_finish verifies a downloaded SROM image.
+static void srom_finish(void) {
+    const pmw3360_srom_t *images[] = {&pmw3360_srom_0x04, &pmw3360_srom_0x81};
+    sim.srom_loads++;
+    for (size_t i = 0; i < sizeof(images) / sizeof(images[0]); i++) {
+        const pmw3360_srom_t *img = images[i];
+        if (bus.index == img->len && memcmp(bus.srom, img->data, img->len) == 0) {
+            bus.srom_loaded = bus.srom_enabled && !bus.srom_spacing_bad;
+            sim.srom_id     = bus.srom_loaded ? img->data[1] : 0;
+            break;
+        }
+    }
+    bus.srom_enabled = false;
+}
+
+// address starts a transaction by an address byte sent at start.
+static void address(uint8_t data, uint64_t start) {
+    if (start < bus.next_ok) {
+        violation("%s: address is sent %llu us early", bus.next_rule, (unsigned long long)(bus.next_ok - start));
+    }
+    bus.write      = (data & 0x80) != 0;
+    bus.addr       = data & 0x7f;
+    bus.addr_start = start;
+    bus.addr_end   = host_us;
+    bus.index      = 0;
+    if (bus.write) {
+        if (bus.addr == pmw3360_SROM_Load_Burst) {
+            if (!bus.srom_enabled) {
+                violation("SROM_Load_Burst without SROM_Enable");
+            }
+            bus.srom_spacing_bad = false;
+            bus.last_byte        = start;
+            bus.phase            = PHASE_SROM;
+        } else {
+            bus.phase = PHASE_WDATA;
+        }
+        return;
+    }
+    switch (bus.addr) {
+        case pmw3360_Motion_Burst:
+            if (!sim.burst_mode) {
+                violation("Motion_Burst is read out of burst mode");
+            }
+            burst_latch();
+            bus.burst_index = 0;
+            bus.phase       = PHASE_BURST;
+            return;
+        case pmw3360_Raw_Data_Burst:
+            if (!bus.capturing) {
+                violation("Raw_Data_Burst without Frame_Capture");
+            } else if (start - bus.capture_start < SIM_FRAME) {
+                violation("Raw_Data_Burst %llu us after Frame_Capture", (unsigned long long)(start - bus.capture_start));
+            }
+            bus.phase = PHASE_RAW;
+            return;
+        default:
+            // Reading other registers exits burst mode.
+            sim.burst_mode = false;
+            bus.phase      = PHASE_RDATA;
+            return;
+    }
+}
+
+void spi_init(void) {}
+
+bool spi_start(pin_t slave_pin, bool lsb_first, uint8_t mode, uint16_t divisor) {
+    // spi_start of QMK fails while a transaction is in progress.
+    if (bus.ncs_low) {
+        return false;
+    }
+    if (slave_pin != PMW3360_NCS_PIN || lsb_first || mode != 3) {
+        violation("spi_start with wrong pin or mode");
+    }
+    if (F_CPU / divisor > 2000000) {
+        violation("SCLK is faster than 2MHz");
+    }
+    bus.ncs_low  = true;
+    bus.ncs_fall = host_us;
+    bus.phase    = PHASE_ADDR;
+    return true;
+}
+
+spi_status_t spi_write(uint8_t data) {
+    uint64_t start = host_us;
+    host_us += SIM_BYTE_US;
+    if (!bus.ncs_low) {
+        violation("spi_write while NCS is high");
+        return SPI_STATUS_ERROR;
+    }
+    switch (bus.phase) {
+        case PHASE_ADDR:
+            address(data, start);
+            break;
+        case PHASE_WDATA:
+            reg_write(bus.addr, data);
+            sim.writes++;
+            bus.data_end = host_us;
+            bus.phase    = PHASE_DONE;
+            break;
+        case PHASE_SROM:
+            if (start - bus.last_byte < SIM_SROM_BYTE) {
+                violation("SROM bytes are spaced by %llu us", (unsigned long long)(start - bus.last_byte));
+                bus.srom_spacing_bad = true;
+            }
+            if (bus.index < sizeof(bus.srom)) {
+                bus.srom[bus.index++] = data;
+            }
+            bus.last_byte = start;
+            break;
+        default:
+            violation("unexpected spi_write");
+            break;
+    }
+    return SPI_STATUS_SUCCESS;
+}
+
+spi_status_t spi_read(void) {
+    uint64_t start = host_us;
+    host_us += SIM_BYTE_US;
+    if (!bus.ncs_low) {
+        violation("spi_read while NCS is high");
+        return SPI_STATUS_ERROR;
+    }
+    uint8_t data = 0;
+    switch (bus.phase) {
+        case PHASE_RDATA:
+            if (start - bus.addr_end < SIM_SRAD) {
+                violation("tSRAD: data is read %llu us after address", (unsigned long long)(start - bus.addr_end));
+            }
+            data = reg_read(bus.addr);
+            sim.reads++;
+            bus.data_end = host_us;
+            bus.phase    = PHASE_DONE;
+            break;
+        case PHASE_BURST:
+            if (bus.burst_index == 0 && start - bus.addr_end < SIM_SRAD_MOTBR) {
+                violation("tSRAD_MOTBR: burst is read %llu us after address", (unsigned long long)(start - bus.addr_end));
+            }
+            if (bus.burst_index < sizeof(bus.burst)) {
+                data = bus.burst[bus.burst_index++];
+            }
+            bus.data_end = host_us;
+            break;
+        case PHASE_RAW:
+            if (bus.index == 0 ? start - bus.addr_end < SIM_SRAD : start - bus.last_byte < SIM_PIXEL) {
+                violation("Raw_Data_Burst byte %u is read too early", bus.index);
+            }
+            bus.last_byte = start;
+            if (bus.index < PMW3360_FRAME_BYTES) {
+                // A gradient, to make the frame recognizable.
+                data = (bus.index % PMW3360_FRAME_WIDTH) + (bus.index / PMW3360_FRAME_WIDTH);
+                bus.index++;
+            }
+            bus.data_end = host_us;
+            break;
+        default:
+            violation("unexpected spi_read");
+            break;
+    }
+    return data;
+}
+
+spi_status_t spi_transmit(const uint8_t *data, uint16_t length) {
+    for (; length > 0; length--) {
+        spi_status_t st = spi_write(*data++);
+        if (st < 0) {
+            return st;
+        }
+    }
+    return SPI_STATUS_SUCCESS;
+}
+
+spi_status_t spi_receive(uint8_t *data, uint16_t length) {
+    for (; length > 0; length--) {
+        spi_status_t st = spi_read();
+        if (st < 0) {
+            return st;
+        }
+        *data++ = st;
+    }
+    return SPI_STATUS_SUCCESS;
+}
+
+void spi_stop(void) {
+    if (!bus.ncs_low) {
+        return;
+    }
+    uint64_t now = host_us;
+    bus.ncs_low  = false;
+    switch (bus.phase) {
+        case PHASE_DONE:
+            if (bus.write) {
+                if (now - bus.data_end < SIM_SCLK_NCS_W) {
+                    violation("tSCLK-NCS: NCS is raised %llu us after write", (unsigned long long)(now - bus.data_end));
+                }
+                if (bus.addr == pmw3360_Power_Up_Reset) {
+                    bus.next_ok   = bus.data_end + SIM_RESET;
+                    bus.next_rule = "Power_Up_Reset";
+                } else {
+                    bus.next_ok   = bus.data_end + SIM_SWW_SWR;
+                    bus.next_rule = "tSWW/tSWR";
+                }
+            } else {
+                bus.next_ok   = bus.data_end + SIM_SRW_SRR;
+                bus.next_rule = "tSRW/tSRR";
+            }
+            break;
+        case PHASE_BURST: {
+            uint32_t low = now - bus.addr_start;
+            sim.bursts++;
+            if (low > sim.burst_ncs_max_us) {
+                sim.burst_ncs_max_us = low;
+            }
+            bus.next_ok   = now + 1;
+            bus.next_rule = "tBEXIT";
+            break;
+        }
+        case PHASE_SROM:
+            srom_finish();
+            bus.next_ok   = now + SIM_SROM_LOAD;
+            bus.next_rule = "SROM download";
+            break;
+        case PHASE_RAW:
+            if (bus.index >= PMW3360_FRAME_BYTES) {
+                sim.frames++;
+                bus.capturing = false;
+            }
+            bus.next_ok   = now + 1;
+            bus.next_rule = "tBEXIT";
+            break;
+        case PHASE_WDATA:
+            violation("NCS is raised without data to write");
+            break;
+        case PHASE_RDATA:
+            bus.next_ok   = now + SIM_SRW_SRR;
+            bus.next_rule = "tSRW/tSRR";
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,74 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Software model of PMW3360DM-T2QU on SPI for host tests.
+//
+// It serves the fake spi_master, decodes register accesses, and checks SPI
+// timings of the datasheet against simulated time.  A violation is counted
+// and logged, so tests can assert that the driver respects all of them.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    // Checks
+    uint32_t violations;          // count of timing or protocol violations
+    char     last_violation[128]; // message of the last violation
+    bool     quiet;               // do not log violations, for negative tests
+
+    // Statistics
+    uint32_t reads;            // register reads
+    uint32_t writes;           // register writes
+    uint32_t bursts;           // motion bursts
+    uint32_t burst_ncs_max_us; // the longest NCS low of a motion burst
+    uint32_t resets;           // Power_Up_Reset
+    uint32_t srom_loads;       // completed SROM_Load_Burst
+    uint32_t frames;           // completed raw frame reads
+
+    // Sensor state
+    uint8_t  regs[128];
+    bool     burst_mode;    // Motion_Burst has been written
+    bool     navigating;    // the sensor tracks motion
+    uint8_t  srom_id;       // ID of loaded SROM, 0 when not loaded
+    uint8_t  srom_corrupt;  // number of next SROM CRC self-tests to fail
+    int32_t  dx;            // motion not read yet
+    int32_t  dy;            // motion not read yet
+    uint64_t last_motion;   // time of the last motion
+    uint8_t  motion_pin;    // pin number of MOTION, 0 when not connected
+} pmw3360_sim_t;
+
+extern pmw3360_sim_t sim;
+
+/// sim_power_on resets the simulator and statistics, like power cycle.
+void sim_power_on(void);
+
+/// sim_move adds motion in counts, which the sensor reports later.  It is
+/// ignored while the sensor is not navigating.
+void sim_move(int16_t dx, int16_t dy);
+
+/// sim_op_mode evaluates operation mode by rest mode registers and time
+/// since the last motion: 0 is Run, 1 to 3 are Rest1 to Rest3.
+uint8_t sim_op_mode(void);
+
+/// sim_motion_pin_read reads MOTION pin, which is low while motion is
+/// pending.
+bool sim_motion_pin_read(void);
+
+/// sim_violations_take returns the count of violations and clears it.
+uint32_t sim_violations_take(void);
@@ -0,0 +1,51 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Minimal assertions for host tests.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                         \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                               \
+    do {                                                                                                             \
+        long long va_ = (long long)(a), vb_ = (long long)(b);                                                        \
+        if (va_ != vb_) {                                                                                            \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %lld, %s = %lld\n", __FILE__, __LINE__, #a, va_, #b, vb_); \
+            test_failures++;                                                                                         \
+        }                                                                                                            \
+    } while (0)
+
+#define RUN(test)                                                             \
+    do {                                                                      \
+        int before_ = test_failures;                                          \
+        test();                                                               \
+        printf("%s %s\n", test_failures == before_ ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#define TEST_EXIT() return test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE
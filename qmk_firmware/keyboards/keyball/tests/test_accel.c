@@ -0,0 +1,68 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host tests of pointer acceleration.
+
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "test.h"
+
+// The default keyball_on_select_accel_curve() passes the curve through, so
+// setting keyball.accel_curve directly emulates any value from the hook.
+#define hook_curve keyball.accel_curve
+
+// accelerate applies acceleration to a report of x counts, and returns the
+// reported length.
+static int16_t accelerate(int16_t x, uint8_t interval) {
+    keyball_motion_t m = {x, 0};
+    report_mouse_t   r = {0};
+    keyball.report_interval = interval;
+    accel_frac_x            = 0;
+    accel_frac_y            = 0;
+    keyball_on_apply_motion_to_mouse_move(&m, &r, false);
+    return abs(r.x) + abs(r.y);
+}
+
+static void test_accel_curve(void) {
+    hook_curve = 0;
+    CHECK_EQ(accelerate(40, KEYBALL_REPORTMOUSE_INTERVAL), 40);
+    hook_curve = 3;
+    CHECK_EQ(accelerate(4, KEYBALL_REPORTMOUSE_INTERVAL), 4);
+    CHECK_EQ(accelerate(40, KEYBALL_REPORTMOUSE_INTERVAL), 120);
+}
+
+// The same speed of the ball gets the same gain at any report rate.
+static void test_accel_fast_interval(void) {
+    hook_curve   = 3;
+    int16_t fast = accelerate(40 * KEYBALL_REPORTMOUSE_FAST_INTERVAL / KEYBALL_REPORTMOUSE_INTERVAL, KEYBALL_REPORTMOUSE_FAST_INTERVAL);
+    CHECK_EQ(fast * KEYBALL_REPORTMOUSE_INTERVAL / KEYBALL_REPORTMOUSE_FAST_INTERVAL, 120);
+}
+
+// A curve out of range from the hook must not index out of the tables.
+static void test_accel_curve_clamped(void) {
+    hook_curve = 3;
+    int16_t v3 = accelerate(40, KEYBALL_REPORTMOUSE_INTERVAL);
+    hook_curve = 200;
+    CHECK_EQ(accelerate(40, KEYBALL_REPORTMOUSE_INTERVAL), v3);
+}
+
+int main(void) {
+    RUN(test_accel_curve);
+    RUN(test_accel_fast_interval);
+    RUN(test_accel_curve_clamped);
+    TEST_EXIT();
+}
@@ -0,0 +1,121 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host replay of fast flicks at high CPI: motion beyond the report range is
+// carried over to following reports, so total pointer travel is kept.  The
+// Makefile builds this with and without KEYBALL_REPORTMOUSE_DRAIN.
+
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+#define hook_curve keyball.accel_curve
+
+static void setup(void) {
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    pointing_device_driver_init();
+    keyboard_post_init_kb();
+    for (int i = 0; i < 200; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+    CHECK(sim.navigating);
+    keyball_set_cpi(CPI_MAX);
+    keyball.this_motion = (keyball_motion_t){0};
+    accel_frac_x        = 0;
+    accel_frac_y        = 0;
+}
+
+typedef struct {
+    int32_t x, y; // sum of reports
+    int     ms;   // ms from the end of the flick until the carry drained
+} flick_t;
+
+// flick moves the ball by (dx, dy) every ms for len ms, and polls reports
+// every 250us like the scan loop until the carry drains.
+static flick_t flick(int16_t dx, int16_t dy, int len) {
+    flick_t f = {0, 0, -1};
+    for (int ms = 0; ms < len + 1000; ms++) {
+        if (ms < len) {
+            sim_move(dx, dy);
+        }
+        for (int i = 0; i < 4; i++) {
+            report_mouse_t rep = pointing_device_driver_get_report((report_mouse_t){0});
+            f.x += rep.x;
+            f.y += rep.y;
+            host_advance_us(250);
+        }
+        if (ms >= len && keyball.this_motion.x == 0 && keyball.this_motion.y == 0 && sim.dx == 0 && sim.dy == 0) {
+            f.ms = ms - len;
+            break;
+        }
+    }
+    return f;
+}
+
+// reported_travel maps the sum of reports back to motion of the ball.
+static int32_t reported_travel(const flick_t *f) {
+    return abs(f->x) + abs(f->y);
+}
+
+static void test_carry_flick(void) {
+    setup();
+    hook_curve = 0;
+    flick_t f  = flick(300, -200, 20);
+    CHECK(f.ms >= 0);
+    CHECK_EQ(reported_travel(&f), 300 * 20 + 200 * 20);
+#ifdef KEYBALL_REPORTMOUSE_DRAIN
+    // back-to-back reports drain 6000 counts by 127 quickly.
+    CHECK(f.ms <= 40);
+#else
+    CHECK(f.ms > 40);
+#endif
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+// Acceleration applies gain to reported motion, and converts motion left by
+// clipping back, so it must drain too.
+static void test_carry_flick_accel(void) {
+    setup();
+    hook_curve = 3;
+    flick_t f  = flick(-250, 150, 20);
+    CHECK(f.ms >= 0);
+    CHECK(reported_travel(&f) >= 250 * 20 + 150 * 20);
+    CHECK_EQ(keyball.this_motion.x, 0);
+    CHECK_EQ(keyball.this_motion.y, 0);
+}
+
+// Repeated flicks don't leave any carry behind.
+static void test_carry_flicks(void) {
+    setup();
+    hook_curve = 0;
+    for (int i = 0; i < 10; i++) {
+        int16_t d = i % 2 ? 180 : -120;
+        flick_t f = flick(d, 0, 5 + i);
+        CHECK(f.ms >= 0);
+        CHECK_EQ(reported_travel(&f), abs(d) * (5 + i));
+    }
+}
+
+int main(void) {
+    RUN(test_carry_flick);
+    RUN(test_carry_flick_accel);
+    RUN(test_carry_flicks);
+    TEST_EXIT();
+}
@@ -0,0 +1,165 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host tests of motion filters: a replay of ball motion through the sensor
+// simulator must report all motion, with the filter adding no more than a
+// report of latency.  DEADZONE drops small motion at rest by design.  It also
+// prints a rough cost of the filter.  The Makefile builds this for each
+// filter by KEYBALL_FILTER_RIGHT.
+
+#include <time.h>
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#    define bench_now() __rdtsc()
+#    define BENCH_UNIT "host TSC cycles"
+#else
+static uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#    define BENCH_UNIT "host ns"
+#endif
+
+#if KEYBALL_FILTER_RIGHT == KEYBALL_FILTER_DEADZONE
+#    define FILTER_NAME "DEADZONE"
+// AT_REST gives motion of a burst at rest, which DEADZONE drops.
+#    define AT_REST(v) (v)
+#elif KEYBALL_FILTER_RIGHT == KEYBALL_FILTER_EMA
+#    define FILTER_NAME "EMA"
+#    define AT_REST(v) 0
+#elif KEYBALL_FILTER_RIGHT == KEYBALL_FILTER_MEDIAN
+#    define FILTER_NAME "MEDIAN"
+#    define AT_REST(v) 0
+#else
+#    error "select a filter by KEYBALL_FILTER_RIGHT"
+#endif
+
+static void setup(void) {
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    pointing_device_driver_init();
+    keyboard_post_init_kb();
+    // wait for the SROM upload.
+    for (int i = 0; i < 200; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+    CHECK(sim.navigating);
+    motion_filter_state = (typeof(motion_filter_state)){0};
+}
+
+// replay feeds trace[i] as motion of the i-th ms and polls reports every
+// 250us like the scan loop.  It returns ms from the last motion until all
+// motion but dropped was reported, or -1 when some motion is left
+// unreported.
+static int replay(const int8_t *trace, int len, int dropped, int *reported) {
+    int total = -dropped, last = 0, done = -1;
+    *reported = 0;
+    for (int ms = 0; ms < len + 4 * KEYBALL_REPORTMOUSE_INTERVAL; ms++) {
+        if (ms < len && trace[ms] != 0) {
+            sim_move(trace[ms], 0);
+            total += trace[ms];
+            last = ms;
+        }
+        for (int i = 0; i < 4; i++) {
+            report_mouse_t rep = pointing_device_driver_get_report((report_mouse_t){0});
+            // one axis of the sensor is one of the report by the model.
+            *reported += rep.x + rep.y;
+            host_advance_us(250);
+        }
+        if (done < 0 && ms >= last && *reported == total) {
+            done = ms - last;
+        } else if (*reported != total) {
+            done = -1;
+        }
+    }
+    return done;
+}
+
+static void test_filter_replay_flick(void) {
+    static const int8_t trace[] = {1, 2, 4, 7, 9, 9, 8, 6, 4, 3, 2, 2, 1, 1, 0, 0, 1};
+    setup();
+    int reported;
+    int lag = replay(trace, sizeof(trace), 0, &reported);
+    CHECK_EQ(reported, 60);
+    CHECK(lag >= 0 && lag <= 2 * KEYBALL_REPORTMOUSE_INTERVAL);
+    CHECK_EQ(motion_filter_state.carry.x, 0);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+// A carry left at rest must be released though bursts have stopped.
+static void test_filter_replay_rest(void) {
+    static const int8_t trace[] = {2};
+    setup();
+    int reported;
+    int lag = replay(trace, sizeof(trace), 0, &reported);
+    CHECK_EQ(reported, 2);
+    CHECK(lag >= 0 && lag <= 2 * KEYBALL_REPORTMOUSE_INTERVAL);
+    CHECK_EQ(motion_filter_state.carry.x, 0);
+}
+
+static void test_filter_negative(void) {
+    static const int8_t trace[] = {-1, -3, -2, -1};
+    setup();
+    int reported;
+    int lag = replay(trace, sizeof(trace), 0, &reported);
+    CHECK_EQ(reported, -7);
+    CHECK(lag >= 0 && lag <= 2 * KEYBALL_REPORTMOUSE_INTERVAL);
+}
+
+// A count of jitter at rest is dropped by DEADZONE, or reported by others.
+static void test_filter_jitter(void) {
+    static const int8_t trace[] = {1};
+    setup();
+    int reported;
+    int lag = replay(trace, sizeof(trace), AT_REST(1), &reported);
+    CHECK_EQ(reported, 1 - AT_REST(1));
+    CHECK(lag >= 0 && lag <= 2 * KEYBALL_REPORTMOUSE_INTERVAL);
+}
+
+// bench_filter prints the cost of motion_filter per burst on the host, which
+// only compares variants of the filter: it is not AVR cycles.
+static void bench_filter(void) {
+    enum { N = 100000 };
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint64_t start = bench_now();
+        for (int i = 0; i < N; i++) {
+            pmw3360_motion_t d = {(int16_t)((i * 7) % 31 - 15), (int16_t)((i * 13) % 17 - 8)};
+            motion_filter(&d);
+            __asm__ volatile("" : : "r"(d.x), "r"(d.y));
+        }
+        uint64_t t = bench_now() - start;
+        best       = t < best ? t : best;
+    }
+    printf("bench: motion_filter " FILTER_NAME " %.1f " BENCH_UNIT "/burst\n", (double)best / N);
+}
+
+int main(void) {
+    RUN(test_filter_replay_flick);
+    RUN(test_filter_replay_rest);
+    RUN(test_filter_negative);
+    RUN(test_filter_jitter);
+    bench_filter();
+    TEST_EXIT();
+}
@@ -0,0 +1,76 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host test of frame capture through keyball: the sensor must track again
+// after a capture, with SROM, CPI and the power profile restored.
+
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+static void run_ms(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+}
+
+static void test_frame_capture_restores_tracking(void) {
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    pointing_device_driver_init();
+    keyboard_post_init_kb();
+    CHECK(keyball.this_have_ball);
+    CHECK_EQ(sim.srom_id, 0x04);
+    keyball_set_cpi(20);
+    pmw3360_power_set(pmw3360_POWER_BALANCED);
+
+    uint8_t req[RAW_EPSIZE] = {KEYBALL_RAW_FRAME_CAPTURE};
+    raw_hid_receive(req, sizeof(req));
+    CHECK(pmw3360_frame_capturing());
+    for (int i = 0; i < 1000 && pmw3360_frame_capturing(); i++) {
+        run_ms(1);
+    }
+    CHECK_EQ(sim.frames, 1);
+    CHECK_EQ(sim.resets, 2);
+
+    // Recovery: reset, SROM upload, then CPI and the power profile.
+    run_ms(200);
+    CHECK(sim.navigating);
+    CHECK_EQ(sim.srom_id, 0x04);
+    CHECK_EQ(pmw3360_srom_id, 0x04);
+    CHECK_EQ(sim.regs[pmw3360_Config1], 19);
+    CHECK(sim.regs[pmw3360_Config2] & 0x20);
+    CHECK_EQ(pmw3360_power_get(), pmw3360_POWER_BALANCED);
+    CHECK_EQ(keyball.this_sensor_recoveries, 0);
+
+    sim_move(5, 7);
+    int moved = 0;
+    for (int i = 0; i < 20; i++) {
+        report_mouse_t rep = pointing_device_driver_get_report((report_mouse_t){0});
+        moved += abs(rep.x) + abs(rep.y);
+        host_advance_us(1000);
+    }
+    CHECK_EQ(moved, 12);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+int main(void) {
+    RUN(test_frame_capture_restores_tracking);
+    TEST_EXIT();
+}
@@ -0,0 +1,124 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host stress test of the motion exchange on secondary: a timer signal
+// stands in for the transport interrupt, and runs rpc_sync_handler() at
+// arbitrary points of the sensor poll.  Every reply must be a consistent
+// snapshot, and totals must add up to all motion at the end.
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+// Each step moves by STEP_X and STEP_Y, so a consistent snapshot always has
+// y == x * STEP_Y / STEP_X.
+#define STEP_X 1
+#define STEP_Y -2
+
+static volatile uint32_t         irq_count;
+static volatile uint32_t         irq_torn;     // snapshots with x and y out of step
+static volatile uint32_t         irq_backward; // snapshots older than the last one
+static volatile int64_t          irq_sum_x;    // motion computed from differences
+static keyball_motion_t          irq_last;
+
+// irq_sync runs a transaction like primary does, and checks the reply.
+static void irq_sync(void) {
+    keyball_sync_request_t req  = {.cpi = keyball.cpi_value, .base_known = true, .base = irq_last};
+    keyball_sync_reply_t   recv = {0};
+    rpc_sync_handler(sizeof(req), &req, sizeof(recv), &recv);
+    uint16_t x = recv.totals.x, y = recv.totals.y;
+    if ((uint16_t)(x * STEP_Y / STEP_X) != y) {
+        irq_torn++;
+    }
+    int16_t dx = x - (uint16_t)irq_last.x;
+    if (dx < 0) {
+        irq_backward++;
+    }
+    irq_sum_x += dx;
+    irq_last = recv.totals;
+    irq_count++;
+}
+
+static void on_alarm(int sig) {
+    irq_sync();
+}
+
+static void alarm_arm(long us) {
+    struct itimerval it = {.it_interval = {0, us}, .it_value = {0, us}};
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+static void test_motion_stress(void) {
+    host_master = false;
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    pointing_device_driver_init();
+    keyboard_post_init_kb();
+    for (int i = 0; i < 200; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+    CHECK(sim.navigating);
+    CHECK(host_rpc_handler == rpc_sync_handler);
+    // the first transaction adjusts layout, which is not a concern here.
+    irq_sync();
+
+    struct sigaction sa = {.sa_handler = on_alarm};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+    alarm_arm(20);
+
+    // interleave bursts of the sensor and direct accumulation, which share
+    // the path of motion_accumulate().
+    int64_t moved = 0;
+    for (uint32_t i = 0; irq_count < 20000 && i < 20000000; i++) {
+        if ((i & 63) == 0) {
+            sim_move(STEP_X, STEP_Y);
+            moved += STEP_X;
+            pointing_device_driver_get_report((report_mouse_t){0});
+            host_advance_us(250);
+        }
+        motion_accumulate(STEP_X, STEP_Y);
+        moved += STEP_X;
+        // wait for a transaction before totals wrap around between them.
+        while (moved - irq_sum_x >= 16384) {
+        }
+    }
+    alarm_arm(0);
+    for (int i = 0; i < 8; i++) {
+        pointing_device_driver_get_report((report_mouse_t){0});
+        host_advance_us(1000);
+    }
+    irq_sync();
+
+    printf("stress: %u transactions, %lld counts\n", (unsigned)irq_count, (long long)moved);
+    CHECK(irq_count >= 1000);
+    CHECK_EQ(irq_torn, 0);
+    CHECK_EQ(irq_backward, 0);
+    CHECK_EQ(irq_sum_x, moved);
+    CHECK_EQ(sim_violations_take(), 0);
+    host_master = true;
+}
+
+int main(void) {
+    RUN(test_motion_stress);
+    TEST_EXIT();
+}
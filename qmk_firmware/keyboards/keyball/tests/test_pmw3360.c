@@ -0,0 +1,246 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host tests of PMW3360 driver against the simulator.
+
+#include <string.h>
+#include "quantum.h"
+#include "host.h"
+#include "drivers/pmw3360/pmw3360.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+static void setup(void) {
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    CHECK(pmw3360_init());
+}
+
+static void test_init(void) {
+    setup();
+    CHECK_EQ(sim.resets, 1);
+    CHECK(pmw3360_check());
+    CHECK_EQ(sim.regs[pmw3360_Config2], 0x00);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_cpi(void) {
+    setup();
+    pmw3360_cpi_set(20);
+    CHECK_EQ(sim.regs[pmw3360_Config1], 20);
+    uint32_t reads = sim.reads;
+    CHECK_EQ(pmw3360_cpi_get(), 20);
+    CHECK_EQ(sim.reads, reads); // served by the shadow
+    pmw3360_cpi_set(0xff);
+    CHECK_EQ(sim.regs[pmw3360_Config1], pmw3360_MAXCPI);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_srom_upload(void) {
+    setup();
+    CHECK(pmw3360_srom_upload(pmw3360_srom_0x04));
+    CHECK_EQ(pmw3360_srom_id, 0x04);
+    CHECK_EQ(sim.srom_id, 0x04);
+    CHECK_EQ(sim.srom_loads, 1);
+    CHECK(!pmw3360_srom_uploading());
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_srom_upload_corrupt(void) {
+    setup();
+    pmw3360_srom_id  = 0;
+    sim.srom_corrupt = PMW3360_SROM_UPLOAD_MAXTRY;
+    CHECK(!pmw3360_srom_upload(pmw3360_srom_0x04));
+    CHECK_EQ(pmw3360_srom_id, 0);
+    CHECK_EQ(sim.srom_loads, PMW3360_SROM_UPLOAD_MAXTRY);
+    // Each retry follows Power_Up_Reset.
+    CHECK_EQ(sim.resets, PMW3360_SROM_UPLOAD_MAXTRY);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_srom_upload_retry(void) {
+    setup();
+    pmw3360_srom_id  = 0;
+    sim.srom_corrupt = 1;
+    CHECK(pmw3360_srom_upload(pmw3360_srom_0x04));
+    CHECK_EQ(pmw3360_srom_id, 0x04);
+    CHECK_EQ(sim.srom_id, 0x04);
+    CHECK_EQ(sim.srom_loads, 2);
+    CHECK_EQ(sim.resets, 2);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_motion_burst(void) {
+    setup();
+    pmw3360_motion_t m = {0};
+    sim_move(10, -5);
+    CHECK(pmw3360_motion_burst(&m));
+    CHECK_EQ(m.x, 10);
+    CHECK_EQ(m.y, -5);
+    // No motion: MOTION pin is not asserted, so no burst.
+    uint32_t bursts = sim.bursts;
+    CHECK(!pmw3360_motion_burst(&m));
+    CHECK_EQ(sim.bursts, bursts);
+    sim_move(-300, 400);
+    CHECK(pmw3360_motion_burst(&m));
+    CHECK_EQ(m.x, -300);
+    CHECK_EQ(m.y, 400);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+// async_step steps an asynchronous motion burst, like the pointing task.
+static bool async_step(pmw3360_motion_t *m) {
+    if (pmw3360_motion_burst_poll()) {
+        return pmw3360_motion_burst_complete(m);
+    }
+    pmw3360_motion_burst_start();
+    return false;
+}
+
+static void test_motion_burst_async(void) {
+    setup();
+    pmw3360_motion_t m = {0};
+    int32_t          x = 0, y = 0;
+    for (int i = 0; i < 1100; i++) {
+        if (i < 1000) {
+            sim_move(3, -2);
+        }
+        if (async_step(&m)) {
+            x += m.x;
+            y += m.y;
+        }
+        host_advance_us(100);
+    }
+    CHECK_EQ(x, 3000);
+    CHECK_EQ(y, -2000);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+// In burst mode, an asynchronous burst must not keep NCS low or wait ticks.
+static void test_motion_burst_async_timing(void) {
+    setup();
+    pmw3360_motion_t m = {0};
+    sim_move(1, 1);
+    CHECK(pmw3360_motion_burst_start()); // enter burst mode
+    CHECK(!pmw3360_motion_burst_poll());
+    wait_ms(2);
+    CHECK(pmw3360_motion_burst_poll());
+    CHECK(pmw3360_motion_burst_complete(&m));
+    for (int i = 0; i < 100; i++) {
+        sim_move(2, 0);
+        uint64_t start = host_us;
+        CHECK(pmw3360_motion_burst_start());
+        CHECK(pmw3360_motion_burst_poll());
+        CHECK(pmw3360_motion_burst_complete(&m));
+        CHECK_EQ(m.x, 2);
+        CHECK(host_us - start < 100);
+        wait_us(50);
+    }
+    CHECK(sim.burst_ncs_max_us < 100);
+    // Ready data survives a register access.
+    sim_move(0, 7);
+    CHECK(pmw3360_motion_burst_start());
+    CHECK(pmw3360_check());
+    CHECK(pmw3360_motion_burst_complete(&m));
+    CHECK_EQ(m.y, 7);
+    // An access while waiting tSWR must wait the rest of it.
+    sim_move(1, 0);
+    CHECK(pmw3360_motion_burst_start());
+    CHECK(pmw3360_check());
+    CHECK(!pmw3360_motion_burst_poll());
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_power_profile(void) {
+    setup();
+    pmw3360_power_set(pmw3360_POWER_BALANCED);
+    CHECK(sim.regs[pmw3360_Config2] & 0x20);
+    CHECK_EQ(sim.regs[pmw3360_Run_Downshift], 0x32);
+    sim_move(1, 0);
+    CHECK_EQ(sim_op_mode(), 0);
+    wait_ms(600);
+    CHECK_EQ(sim_op_mode(), 1);
+    sim_move(1, 0);
+    host_advance_us(600 * 1000);
+    pmw3360_motion_t m;
+    CHECK(pmw3360_motion_burst(&m));
+    CHECK_EQ(pmw3360_op_mode_get(), pmw3360_OP_MODE_REST1);
+    pmw3360_power_set(pmw3360_POWER_LATENCY);
+    CHECK(!(sim.regs[pmw3360_Config2] & 0x20));
+    CHECK_EQ(sim_op_mode(), 0);
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+static void test_frame_capture(void) {
+    setup();
+    uint8_t  buf[32];
+    uint8_t  frame[PMW3360_FRAME_BYTES];
+    uint16_t n = 0;
+    CHECK(pmw3360_frame_capture_start());
+    for (int i = 0; i < 1000 && pmw3360_frame_capturing(); i++) {
+        uint8_t got = pmw3360_frame_capture_read(buf, sizeof(buf));
+        memcpy(frame + n, buf, got);
+        n += got;
+        host_advance_us(1000);
+    }
+    CHECK_EQ(n, PMW3360_FRAME_BYTES);
+    CHECK_EQ(sim.frames, 1);
+    CHECK_EQ(frame[PMW3360_FRAME_WIDTH + 1], 2);
+    // The sensor is reset after the last pixel.
+    CHECK_EQ(sim.resets, 2);
+    wait_ms(50);
+    CHECK(pmw3360_reset_finish());
+    CHECK_EQ(sim_violations_take(), 0);
+}
+
+// The simulator must detect a violation, or other tests prove nothing.
+static void test_sim_detects_violation(void) {
+    setup();
+    sim.quiet = true;
+    spi_start(PMW3360_NCS_PIN, false, 3, F_CPU / 2000000);
+    spi_write(pmw3360_Product_ID);
+    spi_read(); // without tSRAD
+    spi_stop();
+    CHECK_EQ(sim_violations_take(), 1);
+    wait_us(20);
+    spi_start(PMW3360_NCS_PIN, false, 3, F_CPU / 2000000);
+    spi_write(pmw3360_Angle_Tune | 0x80);
+    spi_write(1);
+    wait_us(35);
+    spi_stop();
+    spi_start(PMW3360_NCS_PIN, false, 3, F_CPU / 2000000);
+    spi_write(pmw3360_Product_ID); // without tSWR
+    wait_us(160);
+    spi_read();
+    spi_stop();
+    CHECK_EQ(sim_violations_take(), 1);
+}
+
+int main(void) {
+    RUN(test_init);
+    RUN(test_cpi);
+    RUN(test_srom_upload);
+    RUN(test_srom_upload_corrupt);
+    RUN(test_srom_upload_retry);
+    RUN(test_motion_burst);
+    RUN(test_motion_burst_async);
+    RUN(test_motion_burst_async_timing);
+    RUN(test_power_profile);
+    RUN(test_frame_capture);
+    RUN(test_sim_detects_violation);
+    TEST_EXIT();
+}
@@ -0,0 +1,262 @@
+/*
+Copyright 2022 MURAOKA Taro (aka KoRoN, @kaoriya)
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host tests of KEYBALL_SYNC between primary and secondary.  Both halves run
+// in this process by switching host_master, and only one has the ball.  The
+// Makefile builds this with and without the sensor watchdog.
+
+#include "lib/keyball/keyball.c"
+#include "host.h"
+#include "pmw3360_sim.h"
+#include "test.h"
+
+// secondary_up starts secondary with the ball, and waits for the SROM upload.
+static void secondary_up(void) {
+    host_master = false;
+    sim_power_on();
+    sim.motion_pin = PMW3360_MOTION_PIN;
+    pointing_device_driver_init();
+    keyboard_post_init_kb();
+    for (int i = 0; i < 200; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+    CHECK(sim.navigating);
+}
+
+// A model of the split link, which loses requests and replies at random.
+static int      link_loss; // percentage of lost transactions
+static uint32_t link_seed = 1;
+static bool     link_ok;   // the last transaction has succeeded
+static uint32_t link_count; // transactions
+
+static uint32_t link_rand(void) {
+    link_seed = link_seed * 1103515245u + 12345u;
+    return link_seed >> 16;
+}
+
+static bool link_exec(int8_t id, uint8_t in_len, const void *in_data, uint8_t out_len, void *out_data) {
+    uint32_t r = link_rand() % 100;
+    link_ok    = false;
+    link_count++;
+    if (r * 2 < link_loss) {
+        return false; // the request is lost
+    }
+    host_rpc_handler(in_len, in_data, out_len, out_data);
+    if (r < link_loss) {
+        return false; // the reply is lost
+    }
+    link_ok = true;
+    return true;
+}
+
+static void primary_reset(void) {
+    that_base           = (keyball_motion_t){0};
+    that_base_known     = false;
+    keyball.that_motion = (keyball_motion_t){0};
+}
+
+static void secondary_reset(void) {
+    sync_fresh       = true;
+    sync_replied     = (keyball_motion_t){0};
+    motion_totals[0] = motion_totals[1] = (keyball_motion_t){0};
+    motion_published = 0;
+    motion_unsent    = false;
+}
+
+static void secondary_move(int16_t x) {
+    host_master = false;
+    motion_accumulate(x, -x);
+    host_master = true;
+}
+
+// primary_step runs a sync of primary, and returns motion which it applied.
+static int16_t primary_step(void) {
+    host_advance_us(KEYBALL_TX_GETMOTION_INTERVAL * 1000);
+    rpc_sync_invoke();
+    int16_t x = keyball.that_motion.x;
+    CHECK_EQ(keyball.that_motion.y, -x);
+    keyball.that_motion = (keyball_motion_t){0};
+    return x;
+}
+
+// sync_up starts both halves with a lossless link, and negotiates.
+static void sync_up(void) {
+    secondary_up();
+    host_master   = true;
+    host_rpc_exec = link_exec;
+    link_loss     = 0;
+    secondary_reset();
+    primary_reset();
+    for (int i = 0; i < 4; i++) {
+        primary_step();
+    }
+    CHECK(keyball.that_have_ball);
+}
+
+// CPI from primary takes SPI transfers, which must not run in the transport
+// interrupt.
+static void test_sync_cpi_out_of_handler(void) {
+    secondary_up();
+    uint8_t config1 = sim.regs[pmw3360_Config1];
+
+    keyball_sync_request_t req  = {.cpi = 10};
+    keyball_sync_reply_t   recv = {0};
+    uint32_t               rw   = sim.reads + sim.writes;
+    rpc_sync_handler(sizeof(req), &req, sizeof(recv), &recv);
+    CHECK_EQ(sim.reads + sim.writes, rw);
+    CHECK_EQ(sim.regs[pmw3360_Config1], config1);
+
+    housekeeping_task_kb();
+    CHECK_EQ(keyball.cpi_value, 10);
+    CHECK_EQ(sim.regs[pmw3360_Config1], 9);
+    CHECK_EQ(sim_violations_take(), 0);
+    host_master = true;
+}
+
+// Restarted primary doesn't know the base, so it must not take totals of
+// secondary as motion.
+static void test_sync_primary_reset(void) {
+    sync_up();
+    secondary_move(100);
+    CHECK_EQ(primary_step(), 100);
+    primary_reset();
+    CHECK_EQ(primary_step(), 0);
+    secondary_move(5);
+    CHECK_EQ(primary_step() + primary_step(), 5);
+    host_rpc_exec = NULL;
+}
+
+static void test_sync_secondary_reset(void) {
+    sync_up();
+    secondary_move(30);
+    CHECK_EQ(primary_step(), 30);
+    secondary_reset();
+    CHECK_EQ(primary_step(), 0);
+    secondary_move(7);
+    CHECK_EQ(primary_step() + primary_step(), 7);
+    host_rpc_exec = NULL;
+}
+
+// Random motion over a lossy link, with resets of either half.  The first
+// sync after a reset must apply no motion, and all motion since the last
+// reset must be applied at last.  After primary restarts, the ball rests
+// until a sync succeeds: secondary can't tell motion before the restart from
+// motion after it.
+static void test_sync_lossy(void) {
+    sync_up();
+    link_loss       = 40;
+    int64_t moved   = 0;
+    int64_t applied = 0;
+    int     resets  = 0;
+    int     bogus   = 0;
+    for (int i = 0; i < 5000; i++) {
+        uint32_t r = link_rand() % 100;
+        if (r < 2) {
+            resets++;
+            if (r == 0) {
+                primary_reset();
+                moved   = 0;
+                applied = 0;
+            } else {
+                secondary_reset();
+                moved = applied;
+            }
+            do {
+                if (r == 1) {
+                    secondary_move(1);
+                    moved++;
+                }
+                int16_t d = primary_step();
+                bogus += d != 0;
+            } while (!link_ok);
+            continue;
+        }
+        if (r < 60) {
+            int16_t x = (int16_t)(link_rand() % 7) - 3;
+            secondary_move(x);
+            moved += x;
+        }
+        applied += primary_step();
+    }
+    link_loss = 0;
+    for (int i = 0; i < 4; i++) {
+        applied += primary_step();
+    }
+    CHECK(resets > 50);
+    CHECK_EQ(bogus, 0);
+    CHECK_EQ(applied, moved);
+    host_rpc_exec = NULL;
+}
+
+#if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+// Motion which the failing sensor made on secondary must be dropped when it
+// is recovered.
+static void test_sync_sensor_recovery(void) {
+    sync_up();
+    secondary_move(30);
+    CHECK_EQ(primary_step(), 30);
+
+    uint8_t recoveries = keyball.this_sensor_recoveries;
+    secondary_move(500);
+    sim.regs[pmw3360_Product_ID] = 0;
+    host_master                  = false;
+    for (int i = 0; i < 2000 && keyball.this_sensor_recoveries == recoveries; i++) {
+        housekeeping_task_kb();
+        host_advance_us(1000);
+    }
+    host_master = true;
+    CHECK_EQ(keyball.this_sensor_recoveries, recoveries + 1);
+
+    CHECK_EQ(primary_step(), 0);
+    secondary_move(7);
+    CHECK_EQ(primary_step() + primary_step(), 7);
+    CHECK_EQ(sim_violations_take(), 0);
+    host_rpc_exec = NULL;
+}
+#endif
+
+// An idle link has no transactions after negotiation, but renegotiation with
+// the sensor watchdog, which may find hot-plug on secondary.
+static void test_sync_idle(void) {
+    sync_up();
+    keyball.this_have_ball = false; // no ball to negotiate, nor motion
+    keyball.that_have_ball = false;
+    link_count             = 0;
+    for (int i = 0; i < 5000; i++) {
+        rpc_sync_invoke();
+        host_advance_us(1000);
+    }
+#if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+    CHECK(link_count >= 4 && link_count <= 5);
+#else
+    CHECK_EQ(link_count, 0);
+#endif
+    host_rpc_exec = NULL;
+}
+
+int main(void) {
+    RUN(test_sync_cpi_out_of_handler);
+    RUN(test_sync_primary_reset);
+    RUN(test_sync_secondary_reset);
+    RUN(test_sync_lossy);
+#if KEYBALL_SENSOR_WATCHDOG_INTERVAL > 0
+    RUN(test_sync_sensor_recovery);
+#endif
+    RUN(test_sync_idle);
+    TEST_EXIT();
+}